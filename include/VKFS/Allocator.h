@@ -0,0 +1,145 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_ALLOCATOR_H
+#define VKFS_ALLOCATOR_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <functional>
+#include <vulkan/vulkan.h>
+
+
+namespace VKFS {
+
+    class Allocator;
+
+    struct MemoryBlock;
+
+    enum MemoryCategory {
+        MEMORY_BUFFER, MEMORY_IMAGE, MEMORY_ATTACHMENT, MEMORY_STAGING, MEMORY_CATEGORY_COUNT
+    };
+
+    // Live allocation as listed by Allocator::getLiveAllocations()
+    struct AllocationInfo {
+        std::string owner;
+        MemoryCategory category;
+        VkDeviceMemory memory;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t memoryType;
+        uint32_t heap;
+        bool dedicated;
+    };
+
+    /*
+     * Lightweight handle to a range of device memory. Resources are bound to
+     * (memory, offset); mapped is non-null for host-visible allocations.
+     */
+    struct Allocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+        uint32_t memoryType = 0;
+
+        MemoryBlock* block = nullptr;
+    };
+
+    struct MemoryChunk {
+        VkDeviceSize size;
+        bool free;
+        bool linear;
+    };
+
+    struct MemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t memoryType = 0;
+        void* mapped = nullptr;
+        bool dedicated = false;
+        VkDeviceSize used = 0;
+
+        // Chunks keyed by offset. Neighbouring free chunks are always merged
+        std::map<VkDeviceSize, MemoryChunk> chunks;
+    };
+
+    class Allocator {
+        public:
+            Allocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = 64 * 1024 * 1024);
+            ~Allocator();
+
+            Allocation allocate(VkMemoryRequirements requirements, VkMemoryPropertyFlags properties, bool linear = true,
+                                MemoryCategory category = MEMORY_BUFFER, const std::string& owner = "");
+            Allocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryCategory category = MEMORY_BUFFER, const std::string& owner = "");
+            Allocation allocateForImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL,
+                                        MemoryCategory category = MEMORY_IMAGE, const std::string& owner = "");
+            void free(Allocation& allocation);
+
+            uint32_t getBlockCount();
+            VkDeviceSize getAllocatedBytes();
+            VkDeviceSize getUsedBytes();
+
+            VkDeviceSize getCategoryUsage(MemoryCategory category); // Bytes of live allocations
+            VkDeviceSize getHeapUsage(uint32_t heap); // Bytes of live allocations
+            VkDeviceSize getHeapAllocated(uint32_t heap); // Bytes of VkDeviceMemory blocks
+            const VkPhysicalDeviceMemoryProperties& getMemoryProperties();
+
+            std::vector<AllocationInfo> getLiveAllocations();
+            void dumpAllocations(std::ostream& out);
+
+            // Called outside the allocator lock with the heap a new VkDeviceMemory block was allocated from
+            void setBlockCallback(std::function<void(uint32_t)> callback);
+
+        private:
+            VkPhysicalDevice physicalDevice;
+            VkDevice device;
+            VkDeviceSize blockSize;
+            VkDeviceSize bufferImageGranularity;
+            VkPhysicalDeviceMemoryProperties memProperties;
+
+            std::vector<std::unique_ptr<MemoryBlock>> blocks;
+            std::mutex mutex;
+
+            std::map<std::pair<VkDeviceMemory, VkDeviceSize>, AllocationInfo> live;
+            VkDeviceSize categoryUsage[MEMORY_CATEGORY_COUNT] = {};
+            VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS] = {};
+            VkDeviceSize heapAllocated[VK_MAX_MEMORY_HEAPS] = {};
+            std::function<void(uint32_t)> blockCallback;
+
+            uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+            VkDeviceSize getBlockSize(uint32_t memoryType);
+            MemoryBlock* createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated);
+            void destroyBlock(MemoryBlock* block);
+            bool allocateFromBlock(MemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, bool linear, Allocation& allocation);
+            Allocation allocateLocked(VkMemoryRequirements requirements, VkMemoryPropertyFlags properties, bool linear);
+    };
+
+}
+
+
+#endif //VKFS_ALLOCATOR_H
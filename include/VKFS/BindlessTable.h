@@ -0,0 +1,93 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_BINDLESSTABLE_H
+#define VKFS_BINDLESSTABLE_H
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <map>
+#include <algorithm>
+#include <string>
+#include <vulkan/vulkan.h>
+
+
+namespace VKFS {
+
+    class Device;
+
+    /*
+     * One update-after-bind, partially bound descriptor set shared by the whole
+     * device. Binding 0 is an array of combined image samplers and binding 1 an
+     * array of storage buffers. Resources register once and shaders index the
+     * arrays with the returned slot, so draws never rebind descriptors.
+     */
+    class BindlessTable {
+        public:
+            static const uint32_t TEXTURE_BINDING = 0;
+            static const uint32_t STORAGE_BUFFER_BINDING = 1;
+
+            BindlessTable(Device* device, uint32_t maxTextures = 16384, uint32_t maxStorageBuffers = 4096);
+            ~BindlessTable();
+
+            uint32_t registerTexture(VkDescriptorImageInfo imageInfo);
+            void updateTexture(uint32_t index, VkDescriptorImageInfo imageInfo);
+            void releaseTexture(uint32_t index); // The slot is reused once frames in flight are done with it
+
+            uint32_t registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+            void updateStorageBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+            void releaseStorageBuffer(uint32_t index);
+
+            void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set);
+
+            // Sets of the shaders that use runtime-sized arrays, mapped to the table layout
+            std::map<uint32_t, VkDescriptorSetLayout> matchSets(const std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& sets);
+
+            VkDescriptorSetLayout getDescriptorSetLayout();
+            VkDescriptorSet getSet();
+            uint32_t getTextureCapacity();
+            uint32_t getStorageBufferCapacity();
+
+        private:
+            Device* device;
+
+            VkDescriptorSetLayout descriptorSetLayout;
+            VkDescriptorPool descriptorPool;
+            VkDescriptorSet descriptorSet;
+
+            uint32_t textureCapacity;
+            uint32_t storageBufferCapacity;
+
+            uint32_t nextTexture = 0;
+            uint32_t nextStorageBuffer = 0;
+            std::vector<uint32_t> freeTextures;
+            std::vector<uint32_t> freeStorageBuffers;
+
+            uint32_t acquireSlot(std::vector<uint32_t>& freeSlots, uint32_t& next, uint32_t capacity, const std::string& what);
+    };
+
+}
+
+
+#endif //VKFS_BINDLESSTABLE_H
@@ -0,0 +1,101 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_COMMANDSTATETRACKER_H
+#define VKFS_COMMANDSTATETRACKER_H
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <vulkan/vulkan.h>
+
+
+namespace VKFS {
+
+    struct __BoundDescriptorSets {
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> sets;
+
+        // Dynamic offsets of the last call, only comparable when the same range is bound again
+        uint32_t lastFirstSet = 0;
+        uint32_t lastSetCount = 0;
+        std::vector<uint32_t> lastDynamicOffsets;
+    };
+
+    /*
+     * Remembers what has been bound in the command buffer being recorded and
+     * skips commands that would bind the same thing again. Synchronization
+     * restarts it every time recording begins. Commands recorded around it
+     * directly must be followed by invalidate().
+     */
+    class CommandStateTracker {
+        public:
+            void begin(VkCommandBuffer commandBuffer);
+            void invalidate();
+
+            void bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+            void setViewport(const VkViewport& viewport);
+            void setScissor(const VkRect2D& scissor);
+            void bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset);
+            void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+            void bindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet,
+                                    const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& dynamicOffsets = {});
+
+            // Everything an indexed draw of VertexBuffer or MeshPool needs: full-extent viewport and scissor,
+            // vertex buffer 0, index buffer, sets from set 0 and push constants when pushConstants isn't nullptr
+            void bindDrawState(VkPipelineLayout layout, VkPipeline pipeline, VkExtent2D viewportSize,
+                               VkBuffer vertexBuffer, VkBuffer indexBuffer, VkIndexType indexType,
+                               const std::vector<VkDescriptorSet>& sets, const std::vector<uint32_t>& dynamicOffsets,
+                               VkShaderStageFlags pushConstantsStages = 0, const void* pushConstants = nullptr, uint32_t pushConstantsSize = 0);
+
+            VkCommandBuffer getCommandBuffer();
+            uint64_t getIssuedCount();
+            uint64_t getElidedCount();
+
+        private:
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+            VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+            VkPipeline computePipeline = VK_NULL_HANDLE;
+
+            bool viewportSet = false;
+            VkViewport viewport{};
+            bool scissorSet = false;
+            VkRect2D scissor{};
+
+            std::vector<std::pair<VkBuffer, VkDeviceSize>> vertexBuffers;
+            VkBuffer indexBuffer = VK_NULL_HANDLE;
+            VkDeviceSize indexOffset = 0;
+            VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+            __BoundDescriptorSets graphicsSets;
+            __BoundDescriptorSets computeSets;
+
+            uint64_t issued = 0;
+            uint64_t elided = 0;
+    };
+
+}
+
+
+#endif //VKFS_COMMANDSTATETRACKER_H
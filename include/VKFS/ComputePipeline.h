@@ -5,6 +5,7 @@
 #ifndef VKFS_COMPUTEPIPELINE_H
 #define VKFS_COMPUTEPIPELINE_H
 
+#include <atomic>
 #include <vulkan/vulkan.h>
 #include "Device.h"
 #include "ShaderModule.h"
@@ -15,17 +16,33 @@ namespace VKFS {
 
     class ComputePipeline {
         public:
-            ComputePipeline(VKFS::Device* device, VKFS::ShaderModule* computeShader, std::vector<VKFS::Descriptor*> descriptors);
+            ComputePipeline(VKFS::Device* device, VKFS::ShaderModule* computeShader, std::vector<VKFS::Descriptor*> descriptors, bool deferBuild = false);
+            ~ComputePipeline();
 
-            void dispatch(VKFS::Synchronization* sync, int workingGroupCountX, int workingGroupCountY, int workingGroupCountZ);
+            void build();
+            bool isReady();
+
+            VkPipelineLayout getPipelineLayout();
+            const std::vector<VkDescriptorSetLayout>& getDescriptorSetLayouts();
+            const uint32_t* getLocalSize();
+
+            void setName(const std::string& name); // Pass name in PipelineStatistics
+            std::string getName();
+
+            void dispatch(VKFS::Synchronization* sync, int workingGroupCountX, int workingGroupCountY, int workingGroupCountZ, const std::vector<uint32_t>& dynamicOffsets = {});
 
         private:
             VKFS::Device* device;
+            VKFS::ShaderModule* computeShader;
+            ClearQueue clearQueue;
+            std::atomic<bool> ready{false};
+            std::string name = "Compute";
 
             VkPipeline pipeline;
             VkPipelineLayout pipelineLayout;
 
             std::vector<VKFS::Descriptor*> descriptors;
+            std::vector<VkDescriptorSetLayout> setLayouts;
 
     };
 
@@ -0,0 +1,86 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_DELETIONQUEUE_H
+#define VKFS_DELETIONQUEUE_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <vulkan/vulkan.h>
+#include "UploadContext.h"
+
+
+namespace VKFS {
+
+    class Device;
+
+    struct __Deletion {
+        uint64_t submission; // Last submission issued when the resource was released
+        UploadTicket uploadTicket; // Upload batch that was recording at that point
+        std::function<void()> function;
+    };
+
+    /*
+     * Destroys resources once the GPU can no longer use them, instead of idling the device.
+     * Synchronization registers every graphics and compute submit with its fence; a deletion
+     * is keyed to the last submission issued when it was pushed and runs after that submission,
+     * every earlier one and the pending upload batch have completed.
+     *
+     * collect() is called by Synchronization at the start of each frame. Deletions pushed while
+     * nothing is in flight run immediately. The queue is flushed by the device on destruction.
+     * A resource must not be released while the command buffer currently being recorded uses it.
+     */
+    class DeletionQueue {
+        public:
+            DeletionQueue(Device* device);
+            ~DeletionQueue();
+
+            void push(std::function<void()>&& function);
+            void collect();
+            void flush(); // Waits for the device to go idle and runs every deletion
+
+            uint64_t beginSubmission(VkFence fence); // Done by Synchronization before each submit
+            void completeSubmission(uint64_t submission); // Done by Synchronization once the fence was waited on
+
+            uint64_t getLastSubmission();
+            uint64_t getCompletedSubmission(); // Every submission up to this one has completed
+            size_t getPendingCount();
+
+        private:
+            Device* device;
+            std::mutex mutex;
+
+            std::deque<__Deletion> deletions;
+            std::map<uint64_t, VkFence> inFlight;
+            uint64_t lastSubmission = 0;
+
+            uint64_t completedLocked();
+    };
+
+}
+
+
+#endif //VKFS_DELETIONQUEUE_H
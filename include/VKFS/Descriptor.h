@@ -28,37 +28,118 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <array>
 #include <deque>
 #include <functional>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <tuple>
 #include "__utils.h"
 
 namespace VKFS {
 
+    enum StorageBufferFlagBits {
+        STORAGE_BUFFER_DEVICE_LOCAL = 1, // Device-local memory, written through the staging ring
+        STORAGE_BUFFER_SINGLE = 2 // One buffer shared by all frames in flight, for data the GPU only reads
+    };
+    typedef uint32_t StorageBufferFlags;
+
+    struct __DescriptorBinding {
+        VkDescriptorSetLayoutBinding layoutBinding;
+        VkDeviceSize bufferSize = 0;
+        VkDeviceSize bufferRange = 0;
+        VkBufferUsageFlags bufferUsage = 0;
+        StorageBufferFlags storageFlags = 0;
+        uint32_t elementCount = 1;
+        std::vector<VkDescriptorImageInfo> imageInfos;
+
+        // One buffer per frame in flight, or a single one with STORAGE_BUFFER_SINGLE
+        std::vector<VkBuffer> buffers;
+        std::vector<Allocation> allocations;
+
+        // Dynamic bindings are linear per-frame allocators, rewound when the frame slot is reused
+        VkDeviceSize stride = 0;
+        VkDeviceSize head = 0;
+        uint64_t frameNumber = UINT64_MAX;
+    };
+
     class Descriptor {
         public:
+            Descriptor(Device* device);
             Descriptor(Device* device, VkDescriptorType type, VkShaderStageFlagBits shaderStage);
             ~Descriptor();
 
+            Descriptor* addUniformBuffer(uint32_t binding, VkDeviceSize size, VkShaderStageFlags stages);
+            Descriptor* addStorageBuffer(uint32_t binding, VkDeviceSize elementSize, uint32_t elementCount, VkShaderStageFlags stages, StorageBufferFlags flags = 0);
+            Descriptor* addDynamicUniformBuffer(uint32_t binding, VkDeviceSize elementSize, VkShaderStageFlags stages, uint32_t maxElements = 1024);
+            Descriptor* addDynamicStorageBuffer(uint32_t binding, VkDeviceSize elementSize, VkShaderStageFlags stages, uint32_t maxElements = 1024);
+            Descriptor* addSampler(uint32_t binding, VkDescriptorImageInfo imageInfo, VkShaderStageFlags stages);
+            Descriptor* addSamplerArray(uint32_t binding, const std::vector<VkDescriptorImageInfo>& imageInfos, VkShaderStageFlags stages);
+            Descriptor* addStorageImage(uint32_t binding, VkDescriptorImageInfo imageInfo, VkShaderStageFlags stages);
+            Descriptor* addExternalBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages, uint32_t count = 1); // Written by the caller
+            void build();
+            void buildPushDescriptor(); // Requires VK_KHR_push_descriptor, no sets are allocated
+
             void createUBOSet(unsigned int sizeOf);
-            void createStorageBufferSet(unsigned int sizeOf);
+            void createStorageBufferSet(unsigned int sizeOf, uint32_t elementCount, StorageBufferFlags flags = 0);
             void createSamplerSet(VkDescriptorImageInfo sampler);
             void createStorageImageSet(VkDescriptorImageInfo imageInfo);
 
             void* getBufferForUpdate(Synchronization* sync);
+            void* getBufferForUpdate(Synchronization* sync, uint32_t binding);
+            uint32_t pushDynamic(Synchronization* sync, uint32_t binding, const void* data, VkDeviceSize size);
+            /*
+             * Per-frame buffers update the copy of the frame being recorded. A STORAGE_BUFFER_SINGLE
+             * buffer is shared with frames in flight: device-local ones get the staged copy recorded
+             * on the graphics queue after the frames already submitted, host-visible ones are written
+             * immediately, so the range must not be read by frames in flight.
+             */
+            UploadTicket updateStorageBuffer(Synchronization* sync, uint32_t binding, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+            // Moves the binding into new sets, GPU writes from frames still in flight are not carried over
+            void resizeStorageBuffer(uint32_t binding, uint32_t elementCount);
             VkDescriptorSet getSet(Synchronization* sync);
 
+            // Template data is every binding in binding order, each element a VkDescriptorBufferInfo or VkDescriptorImageInfo
+            size_t getTemplateDataSize();
+            size_t getTemplateOffset(uint32_t binding);
+            void updateWithTemplate(Synchronization* sync, const void* data);
+
+            void push(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set, const std::vector<VkWriteDescriptorSet>& writes);
+            void pushWithTemplate(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set, const void* data);
+            bool isPushDescriptor();
+            uint32_t getDynamicOffsetCount();
+
             VkDescriptorSetLayout getDescriptorSetLayout();
-            VkDescriptorPool getDescriptorPool();
+            const std::vector<VkDescriptorSetLayoutBinding>& getBindings();
         private:
             Device* device;
             ClearQueue clearQueue;
 
-            VkDescriptorSetLayout descriptorSetLayout;
-            VkDescriptorPool descriptorPool;
+            VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+            VkShaderStageFlagBits legacyStage = VK_SHADER_STAGE_ALL;
+
+            std::vector<__DescriptorBinding> bindings;
+            bool built = false;
+
+            std::vector<DescriptorAllocation> descriptorSets;
+
+            bool pushDescriptor = false;
+            PFN_vkCmdPushDescriptorSetKHR cmdPushDescriptorSet = nullptr;
+            PFN_vkCmdPushDescriptorSetWithTemplateKHR cmdPushDescriptorSetWithTemplate = nullptr;
 
-            std::vector<VkDescriptorSet> descriptorSets;
+            std::vector<VkDescriptorUpdateTemplateEntry> templateEntries;
+            size_t templateDataSize = 0;
+            VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+            std::map<std::tuple<VkPipelineBindPoint, VkPipelineLayout, uint32_t>, VkDescriptorUpdateTemplate> pushTemplates;
 
-            std::vector<VkBuffer> uniformBuffers;
-            std::vector<VkDeviceMemory> uniformBuffersMemory;
-            std::vector<void*> uniformBuffersMapped;
+            Descriptor* addBinding(__DescriptorBinding binding);
+            Descriptor* addDynamicBuffer(uint32_t binding, VkDescriptorType type, VkDeviceSize elementSize, VkShaderStageFlags stages, uint32_t maxElements);
+            __DescriptorBinding& findBinding(uint32_t binding);
+            void createLayout(VkDescriptorSetLayoutCreateFlags flags = 0);
+            void buildResources(bool allocateSets);
+            VkDescriptorUpdateTemplate createTemplate(VkDescriptorUpdateTemplateType type, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set);
+            void createBindingBuffers(__DescriptorBinding& binding);
+            void writeSets(__DescriptorBinding* only = nullptr);
     };
 
 }
@@ -0,0 +1,92 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_DESCRIPTORALLOCATOR_H
+#define VKFS_DESCRIPTORALLOCATOR_H
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+
+namespace VKFS {
+
+    class Device;
+    class Synchronization;
+
+    struct DescriptorAllocation {
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+    };
+
+    struct __DescriptorPoolChain {
+        std::vector<VkDescriptorPool> ready;
+        std::vector<VkDescriptorPool> full;
+        VkDescriptorPoolCreateFlags flags = 0;
+        uint32_t nextPoolSets = 0;
+        uint64_t frameNumber = UINT64_MAX;
+    };
+
+    /*
+     * Hands out descriptor sets from chains of shared pools. A pool that runs
+     * out of memory is retired and a bigger one is created, so the number of
+     * sets is not bounded. Freed persistent sets are kept per layout and reused
+     * without a driver call; releasing the layout returns them to their pools,
+     * which take allocations again. Transient sets live in per-frame pools that are
+     * reset the first time the frame slot is used again.
+     */
+    class DescriptorAllocator {
+        public:
+            DescriptorAllocator(Device* device, uint32_t setsPerPool = 64);
+            ~DescriptorAllocator();
+
+            DescriptorAllocation allocate(VkDescriptorSetLayout layout);
+            void free(DescriptorAllocation allocation); // The set must no longer be in use by the GPU
+            void releaseLayout(VkDescriptorSetLayout layout); // Call before destroying a layout whose sets were freed
+
+            // Valid until the same frame slot of sync comes around again
+            VkDescriptorSet allocateTransient(Synchronization* sync, VkDescriptorSetLayout layout);
+
+            uint32_t getPoolCount();
+
+        private:
+            Device* device;
+            uint32_t setsPerPool;
+
+            __DescriptorPoolChain persistent;
+            std::vector<__DescriptorPoolChain> frames;
+            std::unordered_map<VkDescriptorSetLayout, std::vector<DescriptorAllocation>> freeSets;
+
+            VkDescriptorPool createPool(uint32_t maxSets, VkDescriptorPoolCreateFlags flags);
+            DescriptorAllocation allocateFromChain(__DescriptorPoolChain& chain, VkDescriptorSetLayout layout);
+            void resetChain(__DescriptorPoolChain& chain);
+            void destroyChain(__DescriptorPoolChain& chain);
+    };
+
+}
+
+
+#endif //VKFS_DESCRIPTORALLOCATOR_H
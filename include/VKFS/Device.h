@@ -24,22 +24,41 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 #define VKFS_DEVICE_H
 
 #include "Instance.h"
+#include "Allocator.h"
+#include "UploadContext.h"
+#include "StagingRing.h"
+#include "PipelineCache.h"
+#include "DescriptorAllocator.h"
+#include "BindlessTable.h"
+#include "DeletionQueue.h"
 #include "__utils.h"
 #include <optional>
 #include <set>
+#include <atomic>
 
 namespace VKFS {
 
+    class TraceRecorder;
+
     struct QueueFamilyIndices {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
         std::optional<uint32_t> computeFamily;
+        std::optional<uint32_t> transferFamily;
 
-        bool isComplete() {
-            return graphicsFamily.has_value() && presentFamily.has_value() && computeFamily.has_value();
+        bool isComplete(bool requirePresent = true) {
+            return graphicsFamily.has_value() && (presentFamily.has_value() || !requirePresent) && computeFamily.has_value();
         }
     };
 
+    struct HeapBudget {
+        VkDeviceSize size; // Heap size reported by the driver
+        VkDeviceSize budget; // What the process may use, the heap size without VK_EXT_memory_budget
+        VkDeviceSize usage; // Process usage, VKFS blocks only without VK_EXT_memory_budget
+        VkDeviceSize allocated; // Bytes of VKFS memory blocks
+        bool deviceLocal;
+    };
+
     struct SwapChainSupportDetails {
         VkSurfaceCapabilitiesKHR capabilities;
         std::vector<VkSurfaceFormatKHR> formats;
@@ -48,7 +67,7 @@ namespace VKFS {
 
     class Device {
         public:
-            Device(VKFS::Instance* instance, std::vector<const char*> deviceExtensions);
+            Device(VKFS::Instance* instance, std::vector<const char*> deviceExtensions, uint32_t framesInFlight = 2, std::string pipelineCachePath = "", bool bindless = false);
             ~Device();
 
             VkPhysicalDevice getPhysicalDevice();
@@ -56,33 +75,92 @@ namespace VKFS {
 
             VkQueue getGraphicsQueue();
             VkQueue getPresentQueue();
+            bool isHeadless();
             VkQueue getComputeQueue();
+            VkQueue getTransferQueue();
             VkCommandPool getCommandPool();
+            VkCommandPool getTransferCommandPool();
+            bool hasDedicatedTransferQueue();
 
             VkCommandBuffer beginSingleTimeCommands();
             void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-            void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+            // The access and stages that read dstBuffer, the graphics queue only waits for the upload there
+            UploadTicket copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0,
+                                    VkAccessFlags dstAccessMask = VK_ACCESS_MEMORY_READ_BIT, VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
 
             Instance* getInstance();
+            uint32_t getFramesInFlight();
 
             SwapChainSupportDetails getSwapchainSupport();
             QueueFamilyIndices findQueueFamilies();
             VkFormat findDepthFormat();
             uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-            void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+            void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& bufferAllocation,
+                              MemoryCategory category = MEMORY_BUFFER, const std::string& owner = "");
+            void destroyBuffer(VkBuffer buffer, Allocation& bufferAllocation);
+
+            Allocator* getAllocator();
+            UploadContext* getUploadContext();
+            StagingRing* getStagingRing();
+            PipelineCache* getPipelineCache();
+            DescriptorAllocator* getDescriptorAllocator();
+            bool isBindless();
+            bool supportsMultiDrawIndirect();
+            bool supportsDrawIndirectCount();
+            bool supportsPipelineStatistics();
+            bool supportsUpdateTemplates(); // Descriptor update templates, core in Vulkan 1.1
+            BindlessTable* getBindlessTable();
+            DeletionQueue* getDeletionQueue();
+            bool hasMemoryBudget(); // VK_EXT_memory_budget is enabled
+            bool hasCalibratedTimestamps(); // VK_EXT_calibrated_timestamps is enabled
+            std::vector<HeapBudget> getMemoryBudget();
+            // Called when a new memory block brings a heap's usage above threshold (0..1) of its budget,
+            // or when pollMemoryBudget() finds that a heap crossed it, e.g. through other processes
+            void setBudgetCallback(float threshold, std::function<void(uint32_t heap, const HeapBudget& budget)> callback);
+            void pollMemoryBudget(); // Done by Synchronization once per frame
+            TraceRecorder* getTraceRecorder(); // nullptr unless a TraceRecorder is alive
+            // Done by the TraceRecorder constructor and destructor, clearing it waits for spans still recording
+            void setTraceRecorder(TraceRecorder* recorder);
+            // Pins the recorder for a span on any thread, every non-null result needs releaseTraceRecorder()
+            TraceRecorder* acquireTraceRecorder();
+            void releaseTraceRecorder();
 
         private:
             Instance* instance;
             std::vector<const char*> deviceExtensions;
             ClearQueue clearQueue;
+            uint32_t framesInFlight;
 
-            VkPhysicalDevice physicalDevice;
+            VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+            bool headless = false;
             VkDevice device;
+            Allocator* allocator = nullptr;
+            UploadContext* uploadContext = nullptr;
+            StagingRing* stagingRing = nullptr;
+            PipelineCache* pipelineCache = nullptr;
+            DescriptorAllocator* descriptorAllocator = nullptr;
+            bool bindless = false;
+            BindlessTable* bindlessTable = nullptr;
+            DeletionQueue* deletionQueue = nullptr;
+            std::atomic<TraceRecorder*> traceRecorder{nullptr};
+            std::atomic<uint32_t> traceUsers{0}; // Spans that pinned the recorder, pipeline compiler workers record too
+            bool memoryBudget = false;
+            bool calibratedTimestamps = false;
+            bool updateTemplates = false;
+            float budgetThreshold = 0.9f;
+            std::function<void(uint32_t, const HeapBudget&)> budgetCallback;
+            std::vector<bool> heapsOverBudget; // Last poll, so a heap that stays over is reported once
+            bool multiDrawIndirect = false;
+            bool drawIndirectCount = false;
+            bool pipelineStatisticsQuery = false;
 
             VkQueue graphicsQueue = nullptr;
             VkQueue presentQueue = nullptr;
             VkQueue computeQueue = nullptr;
+            VkQueue transferQueue = nullptr;
             VkCommandPool commandPool;
+            VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+            bool dedicatedTransfer = false;
 
             void createLogicalDevice();
             void createCommandPool();
@@ -90,6 +168,11 @@ namespace VKFS {
             bool isDeviceSuitable(VkPhysicalDevice device);
             QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
             bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+            bool checkBindlessSupport(VkPhysicalDevice device);
+            bool supportsVulkan12(VkPhysicalDevice device);
+            bool hasDeviceExtension(VkPhysicalDevice device, const char* extension);
+            void enableExtension(const char* extension);
+            void checkBudget(uint32_t heap);
             SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
             VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     };
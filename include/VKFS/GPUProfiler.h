@@ -0,0 +1,120 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#ifndef VKFS_GPUPROFILER_H
+#define VKFS_GPUPROFILER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <vulkan/vulkan.h>
+#include "Device.h"
+#include "Synchronization.h"
+
+
+namespace VKFS {
+
+    enum ProfilerQueue {
+        PROFILE_GRAPHICS, PROFILE_COMPUTE
+    };
+
+    struct GPUScope {
+        std::string name;
+        ProfilerQueue queue;
+        uint32_t depth = 0; // Number of scopes this one is nested in
+        uint64_t frameNumber = 0;
+
+        // Raw timestamps in ticks of timestampPeriod nanoseconds
+        uint64_t beginTicks = 0;
+        uint64_t endTicks = 0;
+        double milliseconds = 0.0;
+    };
+
+    struct __ProfilerFrame {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        std::vector<GPUScope> scopes; // Scope i owns queries 2 * i and 2 * i + 1
+        std::vector<uint32_t> open;
+    };
+
+    /*
+     * Measures GPU time of named scopes in the graphics and compute command
+     * buffers of a Synchronization object. Every frame in flight has its own
+     * timestamp query pools. A frame's timestamps are read back when its slot
+     * starts recording again: the fence has signaled by then, so reading
+     * never stalls. Results therefore lag framesInFlight frames behind.
+     */
+    class GPUProfiler {
+        public:
+            GPUProfiler(Device* device, Synchronization* sync, uint32_t maxScopes = 256);
+            ~GPUProfiler();
+
+            void beginScope(const std::string& name, ProfilerQueue queue = PROFILE_GRAPHICS);
+            void endScope(ProfilerQueue queue = PROFILE_GRAPHICS);
+
+            // Scopes of the most recent frame that has been read back
+            const std::vector<GPUScope>& getResults(ProfilerQueue queue = PROFILE_GRAPHICS);
+            double getMilliseconds(const std::string& name, ProfilerQueue queue = PROFILE_GRAPHICS); // Sum of every scope with that name
+
+            bool isSupported(ProfilerQueue queue);
+            double getTimestampPeriod();
+
+            // Called with the scopes of every frame as they are read back, after the callbacks added before
+            uint32_t addResultCallback(std::function<void(const std::vector<GPUScope>&)> callback);
+            void removeResultCallback(uint32_t id);
+
+            void beginRecording(ProfilerQueue queue); // Called by Synchronization when a command buffer begins
+
+        private:
+            Device* device;
+            Synchronization* sync;
+            uint32_t maxScopes;
+            double timestampPeriod;
+
+            std::vector<__ProfilerFrame> frames[2];
+            std::vector<GPUScope> results[2];
+            uint64_t timestampMask[2] = {0, 0};
+            std::map<uint32_t, std::function<void(const std::vector<GPUScope>&)>> resultCallbacks;
+            uint32_t nextCallback = 1;
+
+            VkCommandBuffer getCommandBuffer(ProfilerQueue queue);
+            void readResults(ProfilerQueue queue, __ProfilerFrame& frame);
+    };
+
+    // Profiles the GPU work recorded between its construction and destruction
+    class GPUProfileScope {
+        public:
+            GPUProfileScope(GPUProfiler* profiler, const std::string& name, ProfilerQueue queue = PROFILE_GRAPHICS);
+            ~GPUProfileScope();
+
+        private:
+            GPUProfiler* profiler;
+            ProfilerQueue queue;
+    };
+
+}
+
+
+#endif //VKFS_GPUPROFILER_H
@@ -46,27 +46,31 @@ namespace VKFS {
             VkSampler getSampler();
             VkDescriptorImageInfo getDescriptorImageInfo();
             uint32_t getMipLevels();
+            UploadTicket getUploadTicket();
+            uint32_t getBindlessIndex();
 
         private:
             Device* d;
             ImageFilter f;
 
             VkImage image;
-            VkDeviceMemory imageMemory;
+            Allocation imageAllocation;
             VkImageView imageView;
             VkSampler sampler;
             VkDescriptorImageInfo imageInfo;
             uint32_t mipLevels;
+            UploadTicket uploadTicket;
+            uint32_t bindlessIndex = UINT32_MAX;
 
             void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format,
                              VkImageTiling tiling, VkImageUsageFlags usage,
                              VkMemoryPropertyFlags properties, VkImage &image,
-                             VkDeviceMemory &imageMemory);
+                             Allocation &imageAllocation);
 
             void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
                                        uint32_t mipLevels);
 
-            void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+            void copyBufferToImage(VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height);
             void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
             VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
             void changeLayout();
@@ -0,0 +1,76 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_INDIRECTBUFFER_H
+#define VKFS_INDIRECTBUFFER_H
+
+#include <iostream>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "Device.h"
+#include "Synchronization.h"
+
+
+namespace VKFS {
+
+    /*
+     * Device-local array of VkDrawIndexedIndirectCommand with an optional draw
+     * count buffer. The commands can be uploaded from the CPU or written by a
+     * compute shader, which binds getCommandsInfo() and getCountInfo() as
+     * storage buffers. With a count buffer the GPU decides how many draws run.
+     */
+    class IndirectBuffer {
+        public:
+            IndirectBuffer(Device* device, uint32_t maxDraws, bool useCountBuffer = false);
+            ~IndirectBuffer();
+
+            UploadTicket upload(const std::vector<VkDrawIndexedIndirectCommand>& commands);
+            void setDrawCount(uint32_t drawCount); // For commands written by the GPU without a count buffer
+            void resetCount(Synchronization* sync); // Zeroes the count buffer in the compute command buffer
+
+            void draw(Synchronization* sync);
+
+            VkBuffer getBuffer();
+            VkBuffer getCountBuffer();
+            VkDescriptorBufferInfo getCommandsInfo();
+            VkDescriptorBufferInfo getCountInfo();
+            uint32_t getMaxDraws();
+            uint32_t getDrawCount();
+
+        private:
+            Device* device;
+            uint32_t maxDraws;
+            uint32_t drawCount = 0;
+            UploadTicket uploadTicket = 0;
+
+            VkBuffer buffer;
+            Allocation bufferAllocation;
+
+            VkBuffer countBuffer = VK_NULL_HANDLE;
+            Allocation countBufferAllocation;
+    };
+
+}
+
+
+#endif //VKFS_INDIRECTBUFFER_H
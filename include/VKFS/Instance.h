@@ -42,6 +42,7 @@ namespace VKFS {
 
             VkInstance getNative();
             bool isUseDebug();
+            uint32_t getAPIVersion();
 
             std::vector<const char*> validationLayers = {
                     "VK_LAYER_KHRONOS_validation"
@@ -51,8 +52,9 @@ namespace VKFS {
             ClearQueue clearQueue;
             VkInstance instance;
             VkDebugUtilsMessengerEXT debugMessenger;
-            VkSurfaceKHR surface;
+            VkSurfaceKHR surface = VK_NULL_HANDLE;
             bool useDebug = false;
+            uint32_t apiVersion;
 
             bool checkValidationLayerSupport();
             void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
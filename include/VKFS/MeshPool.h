@@ -0,0 +1,238 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#ifndef VKFS_MESHPOOL_H
+#define VKFS_MESHPOOL_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include "Device.h"
+#include "Synchronization.h"
+#include "IndirectBuffer.h"
+#include "__utils.h"
+
+
+namespace VKFS {
+
+    /*
+     * First-fit allocator of element ranges inside a fixed capacity. Freed
+     * ranges are merged with their free neighbours.
+     */
+    class FreeList {
+        public:
+            FreeList(uint32_t capacity);
+
+            bool allocate(uint32_t count, uint32_t& offset);
+            void free(uint32_t offset, uint32_t count);
+
+            uint32_t getCapacity();
+            uint32_t getUsed();
+            uint32_t getLargestFreeRange();
+
+        private:
+            uint32_t capacity;
+            uint32_t used = 0;
+
+            std::map<uint32_t, uint32_t> ranges; // Free ranges, offset -> count
+    };
+
+    struct MeshHandle {
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+    };
+
+    /*
+     * Shared vertex and index buffers that many meshes are sub-allocated from.
+     * Mesh indices stay relative to the mesh, the handle's firstVertex is
+     * passed as vertexOffset when drawing. All meshes share one vertex and one
+     * index buffer binding, so switching meshes costs no binds and a whole set
+     * of meshes can be drawn with one IndirectBuffer.
+     */
+    template<typename Vertex, typename PushConstantsStruct = int>
+    class MeshPool {
+        public:
+            MeshPool(Device* device, uint32_t maxVertices, uint32_t maxIndices) : device(device),
+                    vertexList(std::make_shared<FreeList>(maxVertices)), indexList(std::make_shared<FreeList>(maxIndices)) {
+                if (maxVertices == 0 || maxIndices == 0) {
+                    throw std::runtime_error("[VKFS] Mesh pool needs room for vertices and indices!");
+                }
+
+                device->createBuffer(sizeof(Vertex) * maxVertices, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferAllocation, MEMORY_BUFFER, "MeshPool vertices");
+                device->createBuffer(sizeof(uint32_t) * maxIndices, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferAllocation, MEMORY_BUFFER, "MeshPool indices");
+            }
+
+            ~MeshPool() {
+                Device* d = device;
+                VkBuffer vertices = vertexBuffer, indices = indexBuffer;
+                Allocation vertexAllocation = vertexBufferAllocation, indexAllocation = indexBufferAllocation;
+
+                device->getDeletionQueue()->push([=] () mutable {
+                    d->destroyBuffer(vertices, vertexAllocation);
+                    d->destroyBuffer(indices, indexAllocation);
+                });
+            }
+
+            MeshHandle add(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+                if (vertices.empty() || indices.empty()) {
+                    throw std::runtime_error("[VKFS] Mesh has no vertices or indices!");
+                }
+
+                MeshHandle mesh;
+                mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+                mesh.indexCount = static_cast<uint32_t>(indices.size());
+
+                if (!vertexList->allocate(mesh.vertexCount, mesh.firstVertex)) {
+                    throw std::runtime_error("[VKFS] Mesh pool is out of vertex space!");
+                }
+
+                if (!indexList->allocate(mesh.indexCount, mesh.firstIndex)) {
+                    vertexList->free(mesh.firstVertex, mesh.vertexCount);
+                    throw std::runtime_error("[VKFS] Mesh pool is out of index space!");
+                }
+
+                VkDeviceSize vertexSize = sizeof(Vertex) * vertices.size();
+                StagingAllocation staging = device->getStagingRing()->upload(vertices.data(), vertexSize);
+                uploadTicket = device->copyBuffer(staging.buffer, vertexBuffer, vertexSize, staging.offset, sizeof(Vertex) * mesh.firstVertex,
+                                                  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+
+                VkDeviceSize indexSize = sizeof(uint32_t) * indices.size();
+                staging = device->getStagingRing()->upload(indices.data(), indexSize);
+                uploadTicket = device->copyBuffer(staging.buffer, indexBuffer, indexSize, staging.offset, sizeof(uint32_t) * mesh.firstIndex,
+                                                  VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+
+                meshCount++;
+
+                return mesh;
+            }
+
+            // Frames in flight may still draw the mesh, so its ranges are reused only once they have finished
+            void remove(const MeshHandle& mesh) {
+                std::shared_ptr<FreeList> vertices = vertexList, indices = indexList;
+
+                device->getDeletionQueue()->push([=] () {
+                    vertices->free(mesh.firstVertex, mesh.vertexCount);
+                    indices->free(mesh.firstIndex, mesh.indexCount);
+                });
+
+                meshCount--;
+            }
+
+            VkDrawIndexedIndirectCommand getDrawCommand(const MeshHandle& mesh, uint32_t instanceCount = 1, uint32_t firstInstance = 0) {
+                VkDrawIndexedIndirectCommand command{};
+                command.indexCount = mesh.indexCount;
+                command.instanceCount = instanceCount;
+                command.firstIndex = mesh.firstIndex;
+                command.vertexOffset = static_cast<int32_t>(mesh.firstVertex);
+                command.firstInstance = firstInstance;
+
+                return command;
+            }
+
+            void pushDescriptorSet(VkDescriptorSet set, const std::vector<uint32_t>& dynamicOffsets = {}) {
+                this->layouts.push_back(set);
+                this->dynamicOffsets.insert(this->dynamicOffsets.end(), dynamicOffsets.begin(), dynamicOffsets.end());
+            }
+
+            void pushPushConstants(PushConstantsStruct consts, VkShaderStageFlagBits shaderStage) {
+                this->pushConstants = consts;
+                this->pushConstantsShaderStage = shaderStage;
+            }
+
+            void draw(Synchronization* sync, VkPipelineLayout layout, VkPipeline pipeline, VkExtent2D viewportSize, const MeshHandle& mesh, int count = 1) {
+                bindState(sync, layout, pipeline, viewportSize);
+
+                vkCmdDrawIndexed(sync->getCommandBuffer(), mesh.indexCount, count, mesh.firstIndex, static_cast<int32_t>(mesh.firstVertex), 0);
+            }
+
+            // Draws the commands in indirectBuffer, built with getDrawCommand() or by a compute shader
+            void drawIndirect(Synchronization* sync, VkPipelineLayout layout, VkPipeline pipeline, VkExtent2D viewportSize, IndirectBuffer* indirectBuffer) {
+                bindState(sync, layout, pipeline, viewportSize);
+
+                indirectBuffer->draw(sync);
+            }
+
+            VkBuffer getVertexBuffer() {
+                return this->vertexBuffer;
+            }
+
+            VkBuffer getIndexBuffer() {
+                return this->indexBuffer;
+            }
+
+            UploadTicket getUploadTicket() {
+                return this->uploadTicket;
+            }
+
+            uint32_t getMeshCount() {
+                return this->meshCount;
+            }
+
+            FreeList* getVertexList() {
+                return this->vertexList.get();
+            }
+
+            FreeList* getIndexList() {
+                return this->indexList.get();
+            }
+
+        private:
+            Device* device;
+            VkBuffer vertexBuffer;
+            Allocation vertexBufferAllocation;
+            VkBuffer indexBuffer;
+            Allocation indexBufferAllocation;
+            UploadTicket uploadTicket = 0;
+
+            // Shared with pending remove() deletions, which may outlive the pool
+            std::shared_ptr<FreeList> vertexList;
+            std::shared_ptr<FreeList> indexList;
+            uint32_t meshCount = 0;
+
+            PushConstantsStruct pushConstants;
+            VkShaderStageFlagBits pushConstantsShaderStage;
+
+            std::vector<VkDescriptorSet> layouts;
+            std::vector<uint32_t> dynamicOffsets;
+
+            void bindState(Synchronization* sync, VkPipelineLayout layout, VkPipeline pipeline, VkExtent2D viewportSize) {
+                CommandStateTracker* state = sync->getStateTracker();
+
+                state->bindDrawState(layout, pipeline, viewportSize, vertexBuffer, indexBuffer, VK_INDEX_TYPE_UINT32, layouts, dynamicOffsets,
+                                     pushConstantsShaderStage, std::is_same<PushConstantsStruct, int>::value ? nullptr : &pushConstants, sizeof(PushConstantsStruct));
+
+                layouts.clear();
+                dynamicOffsets.clear();
+            }
+    };
+
+}
+
+
+#endif //VKFS_MESHPOOL_H
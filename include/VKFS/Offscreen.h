@@ -35,7 +35,7 @@ namespace VKFS {
 
     struct __OffscreenImage {
         VkImage image;
-        VkDeviceMemory imageMemory;
+        Allocation imageAllocation;
         VkImageView imageView;
         VkDescriptorImageInfo imageInfo;
     };
@@ -48,6 +48,9 @@ namespace VKFS {
             void beginRenderpass(float clearR = 0, float clearG = 0, float clearB = 0, float clearA = 0);
             void endRenderpass();
 
+            void setName(const std::string& name); // Pass name in PipelineStatistics
+            std::string getName();
+
             VkRenderPass getRenderPass();
             VkExtent2D getExtent();
             VkFramebuffer getFramebuffer();
@@ -58,6 +61,7 @@ namespace VKFS {
             Device* d;
             OffscreenImageFilter filter;
             Synchronization* sync;
+            std::string name = "Offscreen";
 
             ClearQueue clearQueue;
 
@@ -70,7 +74,7 @@ namespace VKFS {
             std::vector<__OffscreenImage> colorImages;
 
             VkImage depthImage;
-            VkDeviceMemory depthImageMemory;
+            Allocation depthImageAllocation;
             VkImageView depthImageView;
 
             VkFramebuffer framebuffer;
@@ -25,6 +25,7 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <iostream>
 #include <vector>
+#include <atomic>
 #include <vulkan/vulkan.h>
 
 #include "Device.h"
@@ -53,14 +54,18 @@ namespace VKFS {
             void setSrcAlphaBlendFactor(VkBlendFactor srcAlphaBlendFactor);
             void setDstAlphaBlendFactor(VkBlendFactor dstAlphaBlendFactor);
             virtual void build();
+            bool isReady();
 
             VkPipeline getPipeline();
             VkPipelineLayout getPipelineLayout();
+            const std::vector<VkDescriptorSetLayout>& getDescriptorSetLayouts();
 
         protected:
             Device* d;
             VkVertexInputBindingDescription bindingDesc;
             std::vector<VkPipelineShaderStageCreateInfo> stages;
+            std::vector<std::string> entryPoints;
+            std::vector<ShaderModule*> shaderModules;
             std::vector<VkVertexInputAttributeDescription> attributes;
             VkVertexInputBindingDescription bindings;
             static VkShaderStageFlagBits getVulkanStage(ShaderType type);
@@ -69,6 +74,7 @@ namespace VKFS {
 
             VkPipeline pipeline;
             VkPipelineLayout layout;
+            std::atomic<bool> ready{false};
 
             VkRenderPass renderPass;
 
@@ -77,6 +83,7 @@ namespace VKFS {
             ShaderType pushConstantsShader;
 
             std::vector<Descriptor*> descriptors;
+            std::vector<VkDescriptorSetLayout> setLayouts;
 
             bool depthTest = true;
             CullMode cullMode = CullMode::NONE;
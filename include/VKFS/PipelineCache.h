@@ -0,0 +1,69 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_PIPELINECACHE_H
+#define VKFS_PIPELINECACHE_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <vulkan/vulkan.h>
+
+
+namespace VKFS {
+
+    class Device;
+
+    /*
+     * VkPipelineCache that is seeded from a file and written back on save() and
+     * on destruction. Cache data from another driver or GPU is detected through
+     * its header (vendor ID, device ID, pipelineCacheUUID) and discarded.
+     */
+    class PipelineCache {
+        public:
+            PipelineCache(Device* device, std::string path = "");
+            ~PipelineCache();
+
+            VkPipelineCache getPipelineCache();
+
+            bool save();
+            bool save(const std::string& path);
+
+            bool isLoadedFromDisk();
+            std::string getPath();
+
+        private:
+            Device* device;
+            std::string path;
+
+            VkPipelineCache pipelineCache;
+            bool loadedFromDisk = false;
+
+            std::vector<char> readFile(const std::string& path);
+            bool isCompatible(const std::vector<char>& data);
+    };
+
+}
+
+
+#endif //VKFS_PIPELINECACHE_H
@@ -0,0 +1,78 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_PIPELINECOMPILER_H
+#define VKFS_PIPELINECOMPILER_H
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include "Pipeline.h"
+#include "ComputePipeline.h"
+
+
+namespace VKFS {
+
+    /*
+     * Builds Pipeline and ComputePipeline objects on a pool of worker threads.
+     * Every compile() returns a future that becomes ready when the pipeline is
+     * built and rethrows build errors on get(). Until then the pipeline's
+     * isReady() is false and the renderer can draw with a fallback pipeline.
+     * All pipelines share the Device pipeline cache, which is thread safe.
+     */
+    class PipelineCompiler {
+        public:
+            PipelineCompiler(uint32_t threadCount = 0);
+            ~PipelineCompiler();
+
+            std::shared_future<void> compile(Pipeline* pipeline);
+            std::shared_future<void> compile(ComputePipeline* pipeline);
+            std::vector<std::shared_future<void>> compile(const std::vector<Pipeline*>& pipelines);
+            std::vector<std::shared_future<void>> compile(const std::vector<ComputePipeline*>& pipelines);
+
+            void waitIdle();
+            uint32_t getPendingCount();
+            uint32_t getThreadCount();
+
+        private:
+            std::vector<std::thread> workers;
+            std::queue<std::packaged_task<void()>> tasks;
+            std::mutex mutex;
+            std::condition_variable taskAvailable;
+            std::condition_variable idle;
+            uint32_t pending = 0;
+            bool stopping = false;
+
+            std::shared_future<void> enqueue(std::function<void()>&& function);
+            void workerLoop();
+    };
+
+}
+
+
+#endif //VKFS_PIPELINECOMPILER_H
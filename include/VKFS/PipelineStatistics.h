@@ -0,0 +1,97 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#ifndef VKFS_PIPELINESTATISTICS_H
+#define VKFS_PIPELINESTATISTICS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <vulkan/vulkan.h>
+#include "Device.h"
+#include "Synchronization.h"
+#include "GPUProfiler.h"
+
+
+namespace VKFS {
+
+    struct PassStatistics {
+        std::string name;
+        uint64_t frameNumber = 0;
+
+        uint64_t inputAssemblyVertices = 0;
+        uint64_t inputAssemblyPrimitives = 0;
+        uint64_t vertexShaderInvocations = 0;
+        uint64_t clippingInvocations = 0;
+        uint64_t clippingPrimitives = 0;
+        uint64_t fragmentShaderInvocations = 0;
+        uint64_t computeShaderInvocations = 0;
+    };
+
+    struct __StatisticsFrame {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        std::vector<std::string> passes; // Pass i owns query i
+        uint64_t frameNumber = 0;
+        bool active = false;
+    };
+
+    /*
+     * Pipeline statistics queries around Offscreen render passes, compute
+     * dispatches and passes marked with beginPass()/endPass(). Like the
+     * GPUProfiler, each frame in flight has its own query pools, which are
+     * read back without waiting once the frame slot records again. Passes
+     * sharing a name in one frame are summed.
+     */
+    class PipelineStatistics {
+        public:
+            PipelineStatistics(Device* device, Synchronization* sync, uint32_t maxPasses = 64);
+            ~PipelineStatistics();
+
+            // Queries of one type cannot nest, a pass begun inside another is not counted
+            void beginPass(const std::string& name, ProfilerQueue queue = PROFILE_GRAPHICS);
+            void endPass(ProfilerQueue queue = PROFILE_GRAPHICS);
+
+            PassStatistics getPass(const std::string& name); // Latest read back counters, zero if never seen
+            std::vector<PassStatistics> getPasses();
+
+            void beginRecording(ProfilerQueue queue); // Called by Synchronization when a command buffer begins
+
+        private:
+            Device* device;
+            Synchronization* sync;
+            uint32_t maxPasses;
+
+            std::vector<__StatisticsFrame> frames[2];
+            std::map<std::string, PassStatistics> results;
+            uint32_t skipped[2] = {0, 0}; // Passes begun while another was active or the pool was full
+
+            VkCommandBuffer getCommandBuffer(ProfilerQueue queue);
+            void readResults(ProfilerQueue queue, __StatisticsFrame& frame);
+    };
+
+}
+
+
+#endif //VKFS_PIPELINESTATISTICS_H
@@ -24,6 +24,7 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 #define VKFS_SHADERMODULE_H
 
 #include "Device.h"
+#include "ShaderReflection.h"
 #include <fstream>
 
 namespace VKFS {
@@ -32,10 +33,12 @@ namespace VKFS {
         public:
             ShaderModule(Device* device, std::string path);
             VkShaderModule getShaderModule();
+            const ShaderReflection& getReflection();
 
         private:
             Device* device;
             VkShaderModule shader;
+            ShaderReflection reflection;
             static std::vector<char> readFile(const std::string& filename);
             VkShaderModule createShaderModule(const std::vector<char>& code);
     };
@@ -0,0 +1,88 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_SHADERREFLECTION_H
+#define VKFS_SHADERREFLECTION_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <vulkan/vulkan.h>
+
+
+namespace VKFS {
+
+    struct ReflectedBinding {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType type;
+        uint32_t count; // 0 for runtime-sized arrays
+    };
+
+    struct ReflectedVertexInput {
+        uint32_t location;
+        VkFormat format;
+    };
+
+    /*
+     * Minimal SPIR-V parser that extracts what is needed to build pipeline layouts:
+     * the entry point stage, descriptor bindings, the push constant block size,
+     * vertex shader inputs and the compute local size.
+     */
+    class ShaderReflection {
+        public:
+            ShaderReflection() = default;
+            ShaderReflection(const uint32_t* code, size_t wordCount);
+
+            VkShaderStageFlagBits getStage() const;
+            const std::string& getEntryPoint() const;
+            const std::vector<ReflectedBinding>& getBindings() const;
+            uint32_t getPushConstantSize() const;
+            const std::vector<ReflectedVertexInput>& getVertexInputs() const;
+            const uint32_t* getLocalSize() const;
+
+            // Bindings of all stages merged per set, stage flags limited to the stages that use each binding
+            static std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> mergeBindings(const std::vector<const ShaderReflection*>& reflections);
+            // One range covering the largest block, visible to every stage that declares one. Size is 0 if no stage does
+            static VkPushConstantRange mergePushConstants(const std::vector<const ShaderReflection*>& reflections);
+
+            // Creates one layout per set index up to the highest used set, unused sets get an empty layout
+            static std::vector<VkDescriptorSetLayout> createSetLayouts(VkDevice device, const std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>>& sets,
+                                                                       const std::map<uint32_t, VkDescriptorSetLayout>& providedLayouts = {});
+            // Throws if the given set layouts do not provide what the shaders declare
+            static void validateSetLayouts(const std::vector<const ShaderReflection*>& reflections, const std::vector<std::vector<VkDescriptorSetLayoutBinding>>& sets);
+
+        private:
+            VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+            std::string entryPoint = "main";
+            std::vector<ReflectedBinding> bindings;
+            uint32_t pushConstantSize = 0;
+            std::vector<ReflectedVertexInput> vertexInputs;
+            uint32_t localSize[3] = {1, 1, 1};
+    };
+
+}
+
+
+#endif //VKFS_SHADERREFLECTION_H
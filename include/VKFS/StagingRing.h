@@ -0,0 +1,89 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_STAGINGRING_H
+#define VKFS_STAGINGRING_H
+
+#include <iostream>
+#include <deque>
+#include <cstring>
+#include <vulkan/vulkan.h>
+#include "Allocator.h"
+#include "UploadContext.h"
+
+
+namespace VKFS {
+
+    class Device;
+
+    struct StagingAllocation {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+    };
+
+    struct __StagingRegion {
+        UploadTicket ticket;
+        uint64_t end;
+    };
+
+    /*
+     * Persistently mapped host-visible buffer that upload staging data is
+     * sub-allocated from. Each allocation is tied to the upload batch that is
+     * recording when it is made and its space is reused once that batch's fence
+     * signals. Payloads larger than half the ring get their own staging buffer,
+     * released when the upload completes.
+     */
+    class StagingRing {
+        public:
+            StagingRing(Device* device, VkDeviceSize capacity = 32 * 1024 * 1024);
+            ~StagingRing();
+
+            StagingAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+            StagingAllocation upload(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16);
+
+            VkBuffer getBuffer();
+            VkDeviceSize getCapacity();
+            VkDeviceSize getUsedBytes();
+
+        private:
+            Device* device;
+
+            VkBuffer buffer;
+            Allocation bufferAllocation;
+            VkDeviceSize capacity;
+
+            // Monotonic byte counters, the ring position is counter % capacity
+            uint64_t head = 0;
+            uint64_t tail = 0;
+            std::deque<__StagingRegion> regions;
+
+            void reclaim();
+            StagingAllocation allocateDedicated(VkDeviceSize size);
+    };
+
+}
+
+
+#endif //VKFS_STAGINGRING_H
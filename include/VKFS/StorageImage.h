@@ -24,14 +24,14 @@ namespace VKFS {
             int width_;
             int height_;
             VkImage image_;
-            VkDeviceMemory imageMemory_;
+            Allocation imageAllocation_;
             VkImageView imageView_;
             VkSampler sampler_;
             VkDescriptorImageInfo descriptorImageInfo;
 
             VkImage shaderImage;
             VkImageView shaderImageView;
-            VkDeviceMemory shaderImageMemory;
+            Allocation shaderImageAllocation;
             VkDescriptorImageInfo shaderDescriptorImageInfo;
 
             void createImageForShader();
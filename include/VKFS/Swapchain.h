@@ -46,16 +46,16 @@ namespace VKFS {
             VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
             VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
             void createFramebuffers();
-            void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+            void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, Allocation& imageAllocation);
 
-            VkSwapchainKHR swapchain;
+            VkSwapchainKHR swapchain = VK_NULL_HANDLE;
             std::vector<VkImage> swapchainImages;
             VkFormat swapchainImageFormat;
             VkExtent2D swapchainExtent;
             std::vector<VkImageView> swapchainImageViews;
             std::vector<VkFramebuffer> swapchainFramebuffers;
             VkImage depthImage;
-            VkDeviceMemory depthImageMemory;
+            Allocation depthImageAllocation;
             VkImageView depthImageView;
 
             VkRenderPass renderPass;
@@ -26,23 +26,37 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Device.h"
 #include "CommandBuffer.h"
 #include "Swapchain.h"
+#include "CommandStateTracker.h"
 
 namespace VKFS {
 
+    class GPUProfiler;
+    class PipelineStatistics;
+
     class Synchronization {
         public:
             Synchronization(Device* device, CommandBuffer* cmd, Swapchain* swapchain);
+            Synchronization(Device* device, CommandBuffer* cmd); // Compute-only, no swapchain or presentation
 
             void waitForFences();
             uint32_t acquireNextImage();
             uint32_t getCurrentFrame();
+            uint64_t getFrameNumber();
+            Device* getDevice();
 
             VkCommandBuffer getCommandBuffer();
             VkCommandBuffer getComputeCommandBuffer();
+            CommandStateTracker* getStateTracker();
+            CommandStateTracker* getComputeStateTracker();
+            GPUProfiler* getProfiler();
+            void setProfiler(GPUProfiler* profiler); // Done by the GPUProfiler constructor
+            PipelineStatistics* getPipelineStatistics();
+            void setPipelineStatistics(PipelineStatistics* statistics); // Done by the PipelineStatistics constructor
 
             void resetAll();
             void resetCompute();
             void waitCompute();
+            void waitComputeIdle();
             void beginRecordingCompute();
             void endRecordingCompute();
             void submit(uint32_t imageIndex);
@@ -61,10 +75,20 @@ namespace VKFS {
             std::vector<VkSemaphore> renderFinishedSemaphores;
             std::vector<VkFence> inFlightFences;
             uint32_t currentFrame = 0;
+            uint64_t frameNumber = 0;
 
             std::vector<VkFence> computeInFlightFences;
             std::vector<VkSemaphore> computeFinishedSemaphores;
 
+            // Deletion queue submission of each slot, completed once its fence was waited on
+            std::vector<uint64_t> submissions;
+            std::vector<uint64_t> computeSubmissions;
+
+            CommandStateTracker stateTracker;
+            CommandStateTracker computeStateTracker;
+            GPUProfiler* profiler = nullptr;
+            PipelineStatistics* statistics = nullptr;
+
             int windowWidth = -1, windowHeight = -1;
             bool computeInUse = false;
     };
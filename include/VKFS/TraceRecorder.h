@@ -0,0 +1,121 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#ifndef VKFS_TRACERECORDER_H
+#define VKFS_TRACERECORDER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vulkan/vulkan.h>
+#include "Device.h"
+#include "GPUProfiler.h"
+
+
+namespace VKFS {
+
+    struct __TraceEvent {
+        std::string name;
+        const char* category;
+        uint64_t start; // Nanoseconds on the CPU clock
+        uint64_t duration;
+        uint32_t pid;
+        uint32_t tid;
+    };
+
+    /*
+     * Collects CPU spans of VKFS calls and GPU scopes of an attached
+     * GPUProfiler on one timeline and writes them as Chrome trace-event
+     * JSON, viewable in chrome://tracing or Perfetto. GPU timestamps are
+     * mapped to the CPU clock with VK_EXT_calibrated_timestamps when the
+     * device enabled it and supports the device and CLOCK_MONOTONIC time
+     * domains; the mapping is refreshed every second as results arrive.
+     * Otherwise one timestamp is measured around a blocking submit, which is
+     * off by up to the submit latency; call calibrate() to measure again.
+     *
+     * Destroying the recorder detaches it from its profilers and waits for
+     * VKFS spans still recording on other threads, e.g. pipeline builds.
+     */
+    class TraceRecorder {
+        public:
+            TraceRecorder(Device* device, size_t maxEvents = 1 << 20);
+            ~TraceRecorder();
+
+            void attachProfiler(GPUProfiler* profiler);
+            void detachProfiler(GPUProfiler* profiler); // Before destroying a profiler the recorder outlives
+            void calibrate();
+            bool hasCalibratedTimestamps();
+
+            void recordCPU(const char* name, const char* category, uint64_t start, uint64_t end);
+            void recordGPU(const GPUScope& scope);
+
+            void write(const std::string& path);
+            void clear();
+            size_t getEventCount();
+
+            static uint64_t now();
+
+        private:
+            Device* device;
+            size_t maxEvents;
+            double timestampPeriod;
+            uint64_t timestampMask;
+
+            PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps = nullptr;
+            uint64_t gpuReference = 0;
+            uint64_t cpuReference = 0;
+            uint64_t lastCalibration = 0;
+
+            std::vector<std::pair<GPUProfiler*, uint32_t>> profilers; // Result callbacks to remove on destruction
+            std::vector<__TraceEvent> events;
+            std::map<std::thread::id, uint32_t> threads;
+            std::mutex mutex;
+
+            uint64_t toCPUTime(uint64_t ticks);
+            uint32_t getThreadIndex();
+    };
+
+    // Records the CPU time between its construction and destruction, does nothing without a recorder
+    class TraceSpan {
+        public:
+            TraceSpan(TraceRecorder* recorder, const char* name, const char* category = "VKFS");
+            // Uses the device's recorder and keeps it alive until the span ends, safe on worker threads
+            TraceSpan(Device* device, const char* name, const char* category = "VKFS");
+            ~TraceSpan();
+
+        private:
+            Device* device = nullptr;
+            TraceRecorder* recorder;
+            const char* name;
+            const char* category;
+            uint64_t start = 0;
+    };
+
+}
+
+
+#endif //VKFS_TRACERECORDER_H
@@ -0,0 +1,153 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef VKFS_UPLOADCONTEXT_H
+#define VKFS_UPLOADCONTEXT_H
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <vulkan/vulkan.h>
+
+
+namespace VKFS {
+
+    class Device;
+
+    // Monotonic id of a submitted upload batch. Ticket 0 is always complete
+    using UploadTicket = uint64_t;
+
+    struct __BufferHandover {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        VkAccessFlags dstAccessMask;
+        VkPipelineStageFlags dstStageMask;
+    };
+
+    struct __UploadBatch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer releaseCommandBuffer = VK_NULL_HANDLE; // Graphics queue, hands buffers back before they are written again
+        VkSemaphore transferFinished = VK_NULL_HANDLE;
+        VkSemaphore releaseFinished = VK_NULL_HANDLE;
+        VkFence transferFence = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkPipelineStageFlags consumerStages = 0; // Stages that read the uploads, the graphics part waits for the transfer there
+        std::vector<__BufferHandover> handovers; // Recorded at submit, after every write of the batch
+        std::unordered_set<VkBuffer> graphicsWritten; // Further writes of these in the batch stay on the graphics queue
+        bool releasing = false;
+        bool streaming = false;
+        bool acquired = false; // Graphics part submitted
+        UploadTicket ticket = 0;
+        std::vector<std::function<void()>> onComplete;
+    };
+
+    /*
+     * Records transfer work (copies, layout transitions, mip generation) into one
+     * command buffer and submits it with a fence instead of idling the queue.
+     * Work is submitted explicitly with submit(), or implicitly by Synchronization
+     * before each frame, so everything recorded before a frame is visible to it.
+     *
+     * When the device has a dedicated transfer queue, getCommandBuffer() records on
+     * that queue and getGraphicsCommandBuffer() records work that needs the graphics
+     * queue (blits, final layout transitions). submit() sends the transfer part on its
+     * own; the graphics part acquires the resources and is submitted by acquirePending()
+     * right before the next frame, waiting for the transfer only at the stages that read
+     * them. Resources written on the transfer queue must be handed over with
+     * transferBufferOwnership() / transferImageOwnership(), buffers the graphics queue
+     * owns are first handed back with releaseBuffer(); copyBuffer() does both.
+     *
+     * submit(true) streams the batch: frames don't wait for it, it is acquired by the first
+     * frame submitted after its transfer finished. Its resources may only be used once
+     * isComplete() returns true for its ticket. Everything recorded since the last submit
+     * belongs to the batch, so submit other uploads before recording streamed ones.
+     */
+    class UploadContext {
+        public:
+            UploadContext(Device* device);
+            ~UploadContext();
+
+            VkCommandBuffer getCommandBuffer();
+            VkCommandBuffer getGraphicsCommandBuffer();
+            UploadTicket getCurrentTicket();
+
+            void transferBufferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+            void transferImageOwnership(VkImage image, VkImageSubresourceRange range, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                        VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+
+            // Releases a buffer range the graphics queue owns to the transfer queue, after frames using it at the recorded stages
+            void releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+
+            /*
+             * Records the copy and hands dst over to the stages that read it. onGraphicsQueue records
+             * it on the graphics queue instead, after earlier frames at those stages, for sources
+             * written by shaders and destinations that frames in flight still use.
+             */
+            void copyBuffer(VkBuffer src, VkBuffer dst, const VkBufferCopy& region, VkAccessFlags dstAccessMask,
+                            VkPipelineStageFlags dstStageMask, bool onGraphicsQueue = false);
+            bool isOwnedByGraphics(VkBuffer buffer);
+            void forgetBuffer(VkBuffer buffer); // Done by Device::destroyBuffer, handles get reused
+
+            UploadTicket submit(bool streaming = false);
+            void acquirePending(); // Done by Synchronization before each frame
+            bool isComplete(UploadTicket ticket);
+            void wait(UploadTicket ticket);
+            void waitIdle();
+
+            void onComplete(std::function<void()>&& function);
+
+        private:
+            Device* device;
+
+            VkCommandPool commandPool;
+            VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+            bool dedicatedTransfer = false;
+            uint32_t graphicsFamily;
+            uint32_t transferFamily;
+
+            __UploadBatch current;
+            bool recording = false;
+
+            // Buffers the graphics queue owns and the stages that use them there
+            std::unordered_map<VkBuffer, VkPipelineStageFlags> graphicsOwned;
+
+            std::deque<__UploadBatch> inFlight;
+            std::vector<__UploadBatch> freeBatches;
+
+            UploadTicket nextTicket = 1;
+            UploadTicket completedTicket = 0;
+
+            void collect();
+            void begin();
+            void acquire(__UploadBatch& batch);
+            __UploadBatch acquireBatch();
+    };
+
+}
+
+
+#endif //VKFS_UPLOADCONTEXT_H
@@ -24,19 +24,35 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef VKFS_VKFS_H
 #define VKFS_VKFS_H
 
+#include "Allocator.h"
 #include "CommandBuffer.h"
+#include "CommandStateTracker.h"
 #include "Device.h"
 #include "Descriptor.h"
+#include "DescriptorAllocator.h"
+#include "BindlessTable.h"
 #include "Instance.h"
 #include "ShaderModule.h"
+#include "ShaderReflection.h"
 #include "Swapchain.h"
 #include "Synchronization.h"
 #include "VertexBuffer.h"
+#include "IndirectBuffer.h"
+#include "IndexConversion.h"
+#include "MeshPool.h"
 #include "Pipeline.h"
 #include "Offscreen.h"
 #include "Image.h"
 #include "ComputePipeline.h"
 #include "StorageImage.h"
+#include "UploadContext.h"
+#include "StagingRing.h"
+#include "PipelineCache.h"
+#include "PipelineCompiler.h"
+#include "GPUProfiler.h"
+#include "PipelineStatistics.h"
+#include "TraceRecorder.h"
+#include "DeletionQueue.h"
 
 namespace VKFS {
 
@@ -25,21 +25,59 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 #define VKFS_VERTEXBUFFER_H
 
 #include <type_traits>
+#include <algorithm>
+#include <cstring>
+#include <memory>
 #include "Device.h"
 #include "Synchronization.h"
+#include "IndirectBuffer.h"
+#include "IndexConversion.h"
 #include "__utils.h"
 
 
 namespace VKFS {
 
+    enum VertexBufferFlagBits {
+        VERTEX_BUFFER_DYNAMIC = 1, // Persistently mapped copy per frame in flight instead of device-local memory
+        VERTEX_BUFFER_DISCARD_CPU_COPY = 2, // vertices and indices are emptied once uploaded
+        VERTEX_BUFFER_32BIT_INDICES = 4, // Keeps 32-bit indices even when 16 bits are enough
+        VERTEX_BUFFER_DISCARD_PER_FRAME = 8 // With VERTEX_BUFFER_DYNAMIC: updates reach only the frame being recorded, for geometry rewritten every frame
+    };
+    typedef uint32_t VertexBufferFlags;
+
+    struct __VertexBufferUpdate {
+        bool index;
+        VkDeviceSize offset;
+        std::shared_ptr<const std::vector<char>> data; // One copy shared by every frame it is queued for
+    };
+
     template<typename Vertex, typename PushConstantsStruct = int>
     class VertexBuffer {
         public:
             std::vector<Vertex> vertices;
             std::vector<uint32_t> indices;
-            VertexBuffer(Device *device, std::vector<Vertex> vertices, std::vector<uint32_t> indices) : device(device) {
+            VertexBuffer(Device *device, std::vector<Vertex> vertices, std::vector<uint32_t> indices, VertexBufferFlags flags = 0) : device(device), flags(flags) {
                 this->vertices = vertices;
                 this->indices = indices;
+                this->vertexCapacity = static_cast<uint32_t>(vertices.size());
+                this->indexCapacity = static_cast<uint32_t>(indices.size());
+                this->indexCount = indexCapacity;
+                selectIndexType();
+
+                createVertexBuffer();
+                createIndexBuffer();
+
+                if (flags & VERTEX_BUFFER_DISCARD_CPU_COPY) {
+                    this->vertices = std::vector<Vertex>();
+                    this->indices = std::vector<uint32_t>();
+                }
+            }
+
+            // Empty buffer with room for maxVertices and maxIndices, filled with updateVertices() and updateIndices()
+            VertexBuffer(Device *device, uint32_t maxVertices, uint32_t maxIndices, VertexBufferFlags flags = VERTEX_BUFFER_DYNAMIC) : device(device), flags(flags | VERTEX_BUFFER_DISCARD_CPU_COPY) {
+                this->vertexCapacity = maxVertices;
+                this->indexCapacity = maxIndices;
+                selectIndexType();
 
                 createVertexBuffer();
                 createIndexBuffer();
@@ -49,64 +87,131 @@ namespace VKFS {
                 clearQueue.flush();
             }
 
-            VkBuffer getVertexBuffer() {
-                return this->vertexBuffer;
+            VkBuffer getVertexBuffer(uint32_t frame = 0) {
+                return this->vertexBuffers[vertexBuffers.size() > 1 ? frame : 0];
             }
 
-            VkBuffer getIndexBuffer() {
-                return this->indexBuffer;
+            VkBuffer getIndexBuffer(uint32_t frame = 0) {
+                return this->indexBuffers[indexBuffers.size() > 1 ? frame : 0];
             }
 
-            void pushDescriptorSet(VkDescriptorSet set) {
-                this->layouts.push_back(set);
+            UploadTicket getUploadTicket() {
+                return this->uploadTicket;
             }
 
-            void pushPushConstants(PushConstantsStruct consts, VkShaderStageFlagBits shaderStage) {
-                this->pushConstants = consts;
-                this->pushConstantsShaderStage = shaderStage;
+            uint32_t getVertexCapacity() {
+                return this->vertexCapacity;
             }
 
-            void draw(Synchronization* sync, VkPipelineLayout layout, VkPipeline pipeline, VkExtent2D viewportSize, int count = 1) {
-                vkCmdBindPipeline(sync->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            uint32_t getIndexCapacity() {
+                return this->indexCapacity;
+            }
 
-                VkViewport viewport{};
-                viewport.x = 0.0f;
-                viewport.y = 0.0f;
-                viewport.width = (float) viewportSize.width;
-                viewport.height = (float) viewportSize.height;
-                viewport.minDepth = 0.0f;
-                viewport.maxDepth = 1.0f;
-                vkCmdSetViewport(sync->getCommandBuffer(), 0, 1, &viewport);
+            // VK_INDEX_TYPE_UINT16 when every vertex can be addressed with 16 bits
+            VkIndexType getIndexType() {
+                return this->indexType;
+            }
 
-                VkRect2D scissor{};
-                scissor.offset = {0, 0};
-                scissor.extent = viewportSize;
-                vkCmdSetScissor(sync->getCommandBuffer(), 0, 1, &scissor);
+            uint32_t getIndexCount() {
+                return this->indexCount;
+            }
 
-                VkBuffer vertexBuffers[] = {vertexBuffer};
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(sync->getCommandBuffer(), 0, 1, vertexBuffers, offsets);
+            // Number of indices draw() uses, for geometry that does not fill the buffer
+            void setIndexCount(uint32_t indexCount) {
+                if (indexCount > indexCapacity) {
+                    throw std::runtime_error("[VKFS] Index count is larger than the vertex buffer!");
+                }
 
-                vkCmdBindIndexBuffer(sync->getCommandBuffer(), indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+                this->indexCount = indexCount;
+            }
 
-                for (int i = 0; i < layouts.size(); i++) {
-                    vkCmdBindDescriptorSets(sync->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, layout, i, 1, &layouts[i], 0, nullptr);
+            /*
+             * Writes count vertices starting at firstVertex. Dynamic buffers write
+             * the mapped copy of the frame being recorded and replay the change on
+             * the other copies once their frames come around, unless the buffer has
+             * VERTEX_BUFFER_DISCARD_PER_FRAME. Device-local buffers
+             * are written through the staging ring, sync may then be nullptr and
+             * the range must not be read by frames in flight.
+             */
+            UploadTicket updateVertices(Synchronization* sync, uint32_t firstVertex, const Vertex* data, uint32_t count) {
+                if (firstVertex + count > vertexCapacity) {
+                    throw std::runtime_error("[VKFS] Vertex update is out of bounds!");
                 }
 
-                if (!std::is_same<PushConstantsStruct, int>::value) {
-                    vkCmdPushConstants(sync->getCommandBuffer(), layout, pushConstantsShaderStage, 0, sizeof(PushConstantsStruct), &pushConstants);
+                if (!(flags & VERTEX_BUFFER_DISCARD_CPU_COPY)) {
+                    std::copy(data, data + count, vertices.begin() + firstVertex);
                 }
 
-                vkCmdDrawIndexed(sync->getCommandBuffer(), static_cast<uint32_t>(indices.size()), count, 0, 0, 0);
-                layouts.clear();
+                return write(sync, false, sizeof(Vertex) * firstVertex, data, sizeof(Vertex) * count);
+            }
+
+            UploadTicket updateVertices(Synchronization* sync, uint32_t firstVertex, const std::vector<Vertex>& data) {
+                return updateVertices(sync, firstVertex, data.data(), static_cast<uint32_t>(data.size()));
+            }
+
+            UploadTicket updateIndices(Synchronization* sync, uint32_t firstIndex, const uint32_t* data, uint32_t count) {
+                if (firstIndex + count > indexCapacity) {
+                    throw std::runtime_error("[VKFS] Index update is out of bounds!");
+                }
+
+                if (!(flags & VERTEX_BUFFER_DISCARD_CPU_COPY)) {
+                    std::copy(data, data + count, indices.begin() + firstIndex);
+                }
+
+                if (indexType == VK_INDEX_TYPE_UINT16) {
+                    std::vector<uint16_t> narrow(count);
+                    narrowIndices(data, narrow.data(), count);
+
+                    return write(sync, true, sizeof(uint16_t) * firstIndex, narrow.data(), sizeof(uint16_t) * count);
+                }
+
+                return write(sync, true, sizeof(uint32_t) * firstIndex, data, sizeof(uint32_t) * count);
+            }
+
+            UploadTicket updateIndices(Synchronization* sync, uint32_t firstIndex, const std::vector<uint32_t>& data) {
+                return updateIndices(sync, firstIndex, data.data(), static_cast<uint32_t>(data.size()));
+            }
+
+            void pushDescriptorSet(VkDescriptorSet set, const std::vector<uint32_t>& dynamicOffsets = {}) {
+                this->layouts.push_back(set);
+                this->dynamicOffsets.insert(this->dynamicOffsets.end(), dynamicOffsets.begin(), dynamicOffsets.end());
+            }
+
+            void pushPushConstants(PushConstantsStruct consts, VkShaderStageFlagBits shaderStage) {
+                this->pushConstants = consts;
+                this->pushConstantsShaderStage = shaderStage;
+            }
+
+            void draw(Synchronization* sync, VkPipelineLayout layout, VkPipeline pipeline, VkExtent2D viewportSize, int count = 1) {
+                bindState(sync, layout, pipeline, viewportSize);
+
+                vkCmdDrawIndexed(sync->getCommandBuffer(), indexCount, count, 0, 0, 0);
+            }
+
+            // Draws the commands in indirectBuffer, which index into this buffer's vertices and indices
+            void drawIndirect(Synchronization* sync, VkPipelineLayout layout, VkPipeline pipeline, VkExtent2D viewportSize, IndirectBuffer* indirectBuffer) {
+                bindState(sync, layout, pipeline, viewportSize);
+
+                indirectBuffer->draw(sync);
             }
 
         private:
             Device* device;
-            VkBuffer vertexBuffer;
-            VkDeviceMemory vertexBufferMemory;
-            VkBuffer indexBuffer;
-            VkDeviceMemory indexBufferMemory;
+            VertexBufferFlags flags;
+            uint32_t vertexCapacity;
+            uint32_t indexCapacity;
+            uint32_t indexCount = 0;
+            VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+            // One buffer per frame in flight with VERTEX_BUFFER_DYNAMIC
+            std::vector<VkBuffer> vertexBuffers;
+            std::vector<Allocation> vertexBufferAllocations;
+            std::vector<VkBuffer> indexBuffers;
+            std::vector<Allocation> indexBufferAllocations;
+            UploadTicket uploadTicket = 0;
+
+            // Writes waiting for the frame copy they have not reached yet
+            std::vector<std::vector<__VertexBufferUpdate>> pendingUpdates;
 
             ClearQueue clearQueue;
 
@@ -114,57 +219,139 @@ namespace VKFS {
             VkShaderStageFlagBits pushConstantsShaderStage;
 
             std::vector<VkDescriptorSet> layouts;
+            std::vector<uint32_t> dynamicOffsets;
 
-            void createVertexBuffer() {
-                VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+            void bindState(Synchronization* sync, VkPipelineLayout layout, VkPipeline pipeline, VkExtent2D viewportSize) {
+                CommandStateTracker* state = sync->getStateTracker();
+                uint32_t frame = 0;
 
-                VkBuffer stagingBuffer;
-                VkDeviceMemory stagingBufferMemory;
-                device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+                if (flags & VERTEX_BUFFER_DYNAMIC) {
+                    frame = sync->getCurrentFrame();
+                    applyPendingUpdates(frame);
+                }
 
-                void* data;
-                vkMapMemory(device->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-                memcpy(data, vertices.data(), (size_t) bufferSize);
-                vkUnmapMemory(device->getDevice(), stagingBufferMemory);
+                state->bindDrawState(layout, pipeline, viewportSize, getVertexBuffer(frame), getIndexBuffer(frame), indexType, layouts, dynamicOffsets,
+                                     pushConstantsShaderStage, std::is_same<PushConstantsStruct, int>::value ? nullptr : &pushConstants, sizeof(PushConstantsStruct));
 
-                device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+                layouts.clear();
+                dynamicOffsets.clear();
+            }
 
-                device->copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+            UploadTicket write(Synchronization* sync, bool index, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+                if (size == 0) {
+                    return 0;
+                }
 
-                vkDestroyBuffer(device->getDevice(), stagingBuffer, nullptr);
-                vkFreeMemory(device->getDevice(), stagingBufferMemory, nullptr);
+                if (!(flags & VERTEX_BUFFER_DYNAMIC)) {
+                    StagingAllocation staging = device->getStagingRing()->upload(data, size);
+                    uploadTicket = device->copyBuffer(staging.buffer, index ? indexBuffers[0] : vertexBuffers[0], size, staging.offset, offset,
+                                                      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
-                clearQueue.push_function([=] () {
-                    vkDestroyBuffer(device->getDevice(), vertexBuffer, nullptr);
-                    vkFreeMemory(device->getDevice(), vertexBufferMemory, nullptr);
-                });
-            }
+                    return uploadTicket;
+                }
 
-            void createIndexBuffer() {
-                VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+                if (sync == nullptr) {
+                    throw std::runtime_error("[VKFS] Updating a dynamic vertex buffer needs the Synchronization object!");
+                }
 
-                VkBuffer stagingBuffer;
-                VkDeviceMemory stagingBufferMemory;
-                device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+                uint32_t frame = sync->getCurrentFrame();
+                applyPendingUpdates(frame);
 
-                void* data;
-                vkMapMemory(device->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-                memcpy(data, indices.data(), (size_t) bufferSize);
-                vkUnmapMemory(device->getDevice(), stagingBufferMemory);
+                std::vector<Allocation>& allocations = index ? indexBufferAllocations : vertexBufferAllocations;
+                memcpy(static_cast<char*>(allocations[frame].mapped) + offset, data, size);
 
-                device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+                // The other copies are rewritten when their own frames come around
+                if ((flags & VERTEX_BUFFER_DISCARD_PER_FRAME) || pendingUpdates.size() < 2) {
+                    return 0;
+                }
 
-                device->copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+                const char* bytes = static_cast<const char*>(data);
+                auto copy = std::make_shared<const std::vector<char>>(bytes, bytes + size);
 
-                vkDestroyBuffer(device->getDevice(), stagingBuffer, nullptr);
-                vkFreeMemory(device->getDevice(), stagingBufferMemory, nullptr);
+                for (uint32_t i = 0; i < pendingUpdates.size(); i++) {
+                    if (i != frame) {
+                        pendingUpdates[i].push_back({index, offset, copy});
+                    }
+                }
 
-                clearQueue.push_function([=] () {
-                    vkDestroyBuffer(device->getDevice(), indexBuffer, nullptr);
-                    vkFreeMemory(device->getDevice(), indexBufferMemory, nullptr);
+                return 0;
+            }
+
+            // The caller waited for the frame's fence, so its copy is no longer read by the GPU
+            void applyPendingUpdates(uint32_t frame) {
+                for (auto& update : pendingUpdates[frame]) {
+                    std::vector<Allocation>& allocations = update.index ? indexBufferAllocations : vertexBufferAllocations;
+                    memcpy(static_cast<char*>(allocations[frame].mapped) + update.offset, update.data->data(), update.data->size());
+                }
+
+                pendingUpdates[frame].clear();
+            }
+
+            void createBuffers(VkDeviceSize size, VkBufferUsageFlags usage, const void* data, std::vector<VkBuffer>& buffers, std::vector<Allocation>& allocations) {
+                // Vulkan does not allow zero-sized buffers
+                VkDeviceSize bufferSize = std::max<VkDeviceSize>(size, 4);
+
+                if (flags & VERTEX_BUFFER_DYNAMIC) {
+                    buffers.resize(device->getFramesInFlight());
+                    allocations.resize(device->getFramesInFlight());
+                    pendingUpdates.resize(device->getFramesInFlight());
+
+                    for (size_t i = 0; i < buffers.size(); i++) {
+                        device->createBuffer(bufferSize, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffers[i], allocations[i], MEMORY_BUFFER, "VertexBuffer");
+
+                        if (data != nullptr && size > 0) {
+                            memcpy(allocations[i].mapped, data, size);
+                        }
+                    }
+                } else {
+                    buffers.resize(1);
+                    allocations.resize(1);
+
+                    device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffers[0], allocations[0], MEMORY_BUFFER, "VertexBuffer");
+
+                    if (data != nullptr && size > 0) {
+                        StagingAllocation staging = device->getStagingRing()->upload(data, size);
+                        uploadTicket = device->copyBuffer(staging.buffer, buffers[0], size, staging.offset, 0,
+                                                          VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+                    }
+                }
+
+                clearQueue.push_function([=, &buffers, &allocations] () {
+                    Device* d = device;
+                    std::vector<VkBuffer> retired = buffers;
+                    std::vector<Allocation> retiredAllocations = allocations;
+
+                    // Frames in flight may still read the buffers, the deletion queue also covers pending uploads
+                    device->getDeletionQueue()->push([=] () mutable {
+                        for (size_t i = 0; i < retired.size(); i++) {
+                            d->destroyBuffer(retired[i], retiredAllocations[i]);
+                        }
+                    });
                 });
             }
 
+            void createVertexBuffer() {
+                createBuffers(sizeof(Vertex) * vertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices.empty() ? nullptr : vertices.data(), vertexBuffers, vertexBufferAllocations);
+            }
+
+            void createIndexBuffer() {
+                if (indexType == VK_INDEX_TYPE_UINT16) {
+                    std::vector<uint16_t> narrow(indices.size());
+                    narrowIndices(indices.data(), narrow.data(), indices.size());
+
+                    createBuffers(sizeof(uint16_t) * indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, narrow.empty() ? nullptr : narrow.data(), indexBuffers, indexBufferAllocations);
+                    return;
+                }
+
+                createBuffers(sizeof(uint32_t) * indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.empty() ? nullptr : indices.data(), indexBuffers, indexBufferAllocations);
+            }
+
+            void selectIndexType() {
+                if (!(flags & VERTEX_BUFFER_32BIT_INDICES) && fitsIn16BitIndices(vertexCapacity)) {
+                    indexType = VK_INDEX_TYPE_UINT16;
+                }
+            }
+
     };
 
 
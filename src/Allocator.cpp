@@ -0,0 +1,395 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/Allocator.h"
+
+static const char* categoryNames[] = {"buffers", "images", "attachments", "staging"};
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static bool onSamePage(VkDeviceSize a, VkDeviceSize b, VkDeviceSize pageSize) {
+    return (a & ~(pageSize - 1)) == (b & ~(pageSize - 1));
+}
+
+VKFS::Allocator::Allocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize) : physicalDevice(physicalDevice), device(device), blockSize(blockSize) {
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    bufferImageGranularity = props.limits.bufferImageGranularity;
+}
+
+VKFS::Allocator::~Allocator() {
+    if (!live.empty()) {
+        std::cout << "[VKFS] " << live.size() << " allocations were not freed before the device was destroyed" << std::endl;
+    }
+
+    for (auto& block : blocks) {
+        if (block->mapped) vkUnmapMemory(device, block->memory);
+        vkFreeMemory(device, block->memory, nullptr);
+    }
+
+    blocks.clear();
+}
+
+uint32_t VKFS::Allocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("[VKFS] Failed to find suitable memory type!");
+}
+
+VkDeviceSize VKFS::Allocator::getBlockSize(uint32_t memoryType) {
+    // Small heaps (e.g. the 256MB host-visible device-local heap) get proportionally smaller blocks
+    VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[memoryType].heapIndex].size;
+    if (heapSize <= 1024ull * 1024 * 1024) {
+        return std::min(blockSize, alignUp(heapSize / 8, 32));
+    }
+
+    return blockSize;
+}
+
+VKFS::MemoryBlock *VKFS::Allocator::createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        return nullptr;
+    }
+
+    heapAllocated[memProperties.memoryTypes[memoryType].heapIndex] += size;
+
+    auto block = std::make_unique<MemoryBlock>();
+    block->memory = memory;
+    block->size = size;
+    block->memoryType = memoryType;
+    block->dedicated = dedicated;
+    block->chunks[0] = {size, true, false};
+
+    // Host-visible blocks stay persistently mapped for their whole lifetime
+    if (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+            vkFreeMemory(device, memory, nullptr);
+            throw std::runtime_error("[VKFS] Failed to map device memory block!");
+        }
+    }
+
+    blocks.push_back(std::move(block));
+    return blocks.back().get();
+}
+
+void VKFS::Allocator::destroyBlock(VKFS::MemoryBlock *block) {
+    heapAllocated[memProperties.memoryTypes[block->memoryType].heapIndex] -= block->size;
+
+    if (block->mapped) vkUnmapMemory(device, block->memory);
+    vkFreeMemory(device, block->memory, nullptr);
+
+    for (auto it = blocks.begin(); it != blocks.end(); it++) {
+        if (it->get() == block) {
+            blocks.erase(it);
+            break;
+        }
+    }
+}
+
+bool VKFS::Allocator::allocateFromBlock(VKFS::MemoryBlock *block, VkDeviceSize size, VkDeviceSize alignment, bool linear,
+                                        VKFS::Allocation &allocation) {
+    for (auto it = block->chunks.begin(); it != block->chunks.end(); it++) {
+        if (!it->second.free || it->second.size < size) continue;
+
+        VkDeviceSize chunkOffset = it->first;
+        VkDeviceSize chunkEnd = chunkOffset + it->second.size;
+        VkDeviceSize offset = alignUp(chunkOffset, alignment);
+
+        // Free chunks are always merged, so the neighbours of a free chunk are in use.
+        // Linear and optimal resources must not share a bufferImageGranularity page
+        if (bufferImageGranularity > 1 && it != block->chunks.begin()) {
+            auto prev = std::prev(it);
+            if (prev->second.linear != linear && onSamePage(prev->first + prev->second.size - 1, offset, bufferImageGranularity)) {
+                offset = alignUp(offset, bufferImageGranularity);
+            }
+        }
+
+        if (offset + size > chunkEnd) continue;
+
+        auto next = std::next(it);
+        if (bufferImageGranularity > 1 && next != block->chunks.end() && next->second.linear != linear &&
+            onSamePage(offset + size - 1, next->first, bufferImageGranularity)) {
+            continue;
+        }
+
+        block->chunks.erase(it);
+        if (offset > chunkOffset) block->chunks[chunkOffset] = {offset - chunkOffset, true, false};
+        block->chunks[offset] = {size, false, linear};
+        if (offset + size < chunkEnd) block->chunks[offset + size] = {chunkEnd - offset - size, true, false};
+
+        block->used += size;
+
+        allocation.memory = block->memory;
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+        allocation.memoryType = block->memoryType;
+        allocation.block = block;
+
+        return true;
+    }
+
+    return false;
+}
+
+VKFS::Allocation VKFS::Allocator::allocate(VkMemoryRequirements requirements, VkMemoryPropertyFlags properties, bool linear,
+                                           VKFS::MemoryCategory category, const std::string &owner) {
+    Allocation allocation;
+    bool newBlock;
+    uint32_t heap;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        size_t blockCount = blocks.size();
+        allocation = allocateLocked(requirements, properties, linear);
+        newBlock = blocks.size() > blockCount;
+        heap = memProperties.memoryTypes[allocation.memoryType].heapIndex;
+
+        live[{allocation.memory, allocation.offset}] = {owner, category, allocation.memory, allocation.offset, allocation.size,
+                                                       allocation.memoryType, heap, allocation.block->dedicated};
+        categoryUsage[category] += allocation.size;
+        heapUsage[heap] += allocation.size;
+    }
+
+    // The callback may query the allocator, so it runs without the lock
+    if (newBlock && blockCallback) {
+        blockCallback(heap);
+    }
+
+    return allocation;
+}
+
+VKFS::Allocation VKFS::Allocator::allocateLocked(VkMemoryRequirements requirements, VkMemoryPropertyFlags properties, bool linear) {
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    VkDeviceSize preferredSize = getBlockSize(memoryType);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+    Allocation allocation{};
+
+    // Large resources get their own VkDeviceMemory instead of fragmenting shared blocks
+    if (requirements.size > preferredSize / 2) {
+        MemoryBlock* block = createBlock(memoryType, requirements.size, true);
+        if (block == nullptr) {
+            throw std::runtime_error("[VKFS] Failed to allocate device memory!");
+        }
+
+        allocateFromBlock(block, requirements.size, alignment, linear, allocation);
+        return allocation;
+    }
+
+    for (auto& block : blocks) {
+        if (block->dedicated || block->memoryType != memoryType) continue;
+        if (allocateFromBlock(block.get(), requirements.size, alignment, linear, allocation)) {
+            return allocation;
+        }
+    }
+
+    // Retry with smaller blocks when the driver refuses the preferred size
+    MemoryBlock* block = nullptr;
+    for (VkDeviceSize size = preferredSize; block == nullptr && size >= requirements.size; size /= 2) {
+        block = createBlock(memoryType, size, false);
+    }
+
+    if (block == nullptr || !allocateFromBlock(block, requirements.size, alignment, linear, allocation)) {
+        throw std::runtime_error("[VKFS] Failed to allocate device memory!");
+    }
+
+    return allocation;
+}
+
+VKFS::Allocation VKFS::Allocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, VKFS::MemoryCategory category, const std::string &owner) {
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    Allocation allocation = allocate(memRequirements, properties, true, category, owner);
+
+    if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        free(allocation);
+        throw std::runtime_error("[VKFS] Failed to bind buffer memory!");
+    }
+
+    return allocation;
+}
+
+VKFS::Allocation VKFS::Allocator::allocateForImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling,
+                                                   VKFS::MemoryCategory category, const std::string &owner) {
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    Allocation allocation = allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR, category, owner);
+
+    if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        free(allocation);
+        throw std::runtime_error("[VKFS] Failed to bind image memory!");
+    }
+
+    return allocation;
+}
+
+void VKFS::Allocator::free(VKFS::Allocation &allocation) {
+    if (allocation.block == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryBlock* block = allocation.block;
+    VkDeviceSize offset = allocation.offset;
+
+    auto record = live.find({allocation.memory, offset});
+    if (record != live.end()) {
+        categoryUsage[record->second.category] -= record->second.size;
+        heapUsage[record->second.heap] -= record->second.size;
+        live.erase(record);
+    }
+
+    allocation = Allocation{};
+
+    if (block->dedicated) {
+        destroyBlock(block);
+        return;
+    }
+
+    auto it = block->chunks.find(offset);
+    if (it == block->chunks.end() || it->second.free) {
+        throw std::runtime_error("[VKFS] Attempt to free invalid allocation!");
+    }
+
+    it->second.free = true;
+    block->used -= it->second.size;
+
+    auto next = std::next(it);
+    if (next != block->chunks.end() && next->second.free) {
+        it->second.size += next->second.size;
+        block->chunks.erase(next);
+    }
+
+    if (it != block->chunks.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second.free) {
+            prev->second.size += it->second.size;
+            block->chunks.erase(it);
+        }
+    }
+
+    // Keep one empty block per memory type around to avoid churn when resources are recreated
+    if (block->used == 0) {
+        for (auto& other : blocks) {
+            if (other.get() != block && !other->dedicated && other->memoryType == block->memoryType && other->used == 0) {
+                destroyBlock(block);
+                return;
+            }
+        }
+    }
+}
+
+uint32_t VKFS::Allocator::getBlockCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<uint32_t>(blocks.size());
+}
+
+VkDeviceSize VKFS::Allocator::getAllocatedBytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    VkDeviceSize total = 0;
+    for (auto& block : blocks) total += block->size;
+    return total;
+}
+
+VkDeviceSize VKFS::Allocator::getUsedBytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    VkDeviceSize total = 0;
+    for (auto& block : blocks) total += block->used;
+    return total;
+}
+
+VkDeviceSize VKFS::Allocator::getCategoryUsage(VKFS::MemoryCategory category) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return categoryUsage[category];
+}
+
+VkDeviceSize VKFS::Allocator::getHeapUsage(uint32_t heap) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return heap < VK_MAX_MEMORY_HEAPS ? heapUsage[heap] : 0;
+}
+
+VkDeviceSize VKFS::Allocator::getHeapAllocated(uint32_t heap) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return heap < VK_MAX_MEMORY_HEAPS ? heapAllocated[heap] : 0;
+}
+
+const VkPhysicalDeviceMemoryProperties &VKFS::Allocator::getMemoryProperties() {
+    return this->memProperties;
+}
+
+std::vector<VKFS::AllocationInfo> VKFS::Allocator::getLiveAllocations() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<AllocationInfo> allocations;
+    allocations.reserve(live.size());
+
+    for (auto& record : live) {
+        allocations.push_back(record.second);
+    }
+
+    return allocations;
+}
+
+void VKFS::Allocator::dumpAllocations(std::ostream &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    out << "[VKFS] " << live.size() << " live allocations in " << blocks.size() << " blocks" << std::endl;
+
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+        out << "  heap " << i << ": " << heapUsage[i] << " used, " << heapAllocated[i] << " allocated of " << memProperties.memoryHeaps[i].size << " bytes" << std::endl;
+    }
+
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        out << "  " << categoryNames[i] << ": " << categoryUsage[i] << " bytes" << std::endl;
+    }
+
+    for (auto& record : live) {
+        const AllocationInfo& info = record.second;
+        out << "  " << (info.owner.empty() ? "(unnamed)" : info.owner) << " [" << categoryNames[info.category] << "] " << info.size << " bytes, heap "
+            << info.heap << ", type " << info.memoryType << ", offset " << info.offset << (info.dedicated ? ", dedicated" : "") << std::endl;
+    }
+}
+
+void VKFS::Allocator::setBlockCallback(std::function<void(uint32_t)> callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->blockCallback = callback;
+}
@@ -0,0 +1,228 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/BindlessTable.h"
+#include "../include/VKFS/Device.h"
+
+VKFS::BindlessTable::BindlessTable(VKFS::Device *device, uint32_t maxTextures, uint32_t maxStorageBuffers) : device(device) {
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(device->getPhysicalDevice(), &properties);
+
+    textureCapacity = std::min({maxTextures, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    storageBufferCapacity = std::min({maxStorageBuffers, indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+
+    // Create layout
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = TEXTURE_BINDING;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = textureCapacity;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+
+    bindings[1].binding = STORAGE_BUFFER_BINDING;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = storageBufferCapacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+    // Slots may be written while the set is bound, and unwritten slots are allowed as long as shaders don't read them
+    VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    std::array<VkDescriptorBindingFlags, 2> bindingFlags = {flags, flags};
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device->getDevice(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to create bindless descriptor set layout!");
+    }
+
+    // Create pool with the single set
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = textureCapacity;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = storageBufferCapacity;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        vkDestroyDescriptorSetLayout(device->getDevice(), descriptorSetLayout, nullptr);
+        throw std::runtime_error("[VKFS] Failed to create bindless descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        vkDestroyDescriptorPool(device->getDevice(), descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device->getDevice(), descriptorSetLayout, nullptr);
+        throw std::runtime_error("[VKFS] Failed to allocate bindless descriptor set!");
+    }
+}
+
+VKFS::BindlessTable::~BindlessTable() {
+    vkDestroyDescriptorPool(device->getDevice(), descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device->getDevice(), descriptorSetLayout, nullptr);
+}
+
+uint32_t VKFS::BindlessTable::acquireSlot(std::vector<uint32_t> &freeSlots, uint32_t &next, uint32_t capacity, const std::string &what) {
+    if (!freeSlots.empty()) {
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    if (next >= capacity) {
+        throw std::runtime_error("[VKFS] Bindless table is out of " + what + " slots!");
+    }
+
+    return next++;
+}
+
+uint32_t VKFS::BindlessTable::registerTexture(VkDescriptorImageInfo imageInfo) {
+    uint32_t index = acquireSlot(freeTextures, nextTexture, textureCapacity, "texture");
+    updateTexture(index, imageInfo);
+    return index;
+}
+
+void VKFS::BindlessTable::updateTexture(uint32_t index, VkDescriptorImageInfo imageInfo) {
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = TEXTURE_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(device->getDevice(), 1, &write, 0, nullptr);
+}
+
+void VKFS::BindlessTable::releaseTexture(uint32_t index) {
+    // Frames in flight may still read the slot, so it is only rewritten once they are done
+    device->getDeletionQueue()->push([this, index] () {
+        freeTextures.push_back(index);
+    });
+}
+
+uint32_t VKFS::BindlessTable::registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    uint32_t index = acquireSlot(freeStorageBuffers, nextStorageBuffer, storageBufferCapacity, "storage buffer");
+    updateStorageBuffer(index, buffer, offset, range);
+    return index;
+}
+
+void VKFS::BindlessTable::updateStorageBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = offset;
+    bufferInfo.range = range;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = STORAGE_BUFFER_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.descriptorCount = 1;
+    write.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(device->getDevice(), 1, &write, 0, nullptr);
+}
+
+void VKFS::BindlessTable::releaseStorageBuffer(uint32_t index) {
+    device->getDeletionQueue()->push([this, index] () {
+        freeStorageBuffers.push_back(index);
+    });
+}
+
+void VKFS::BindlessTable::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set) {
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, set, 1, &descriptorSet, 0, nullptr);
+}
+
+std::map<uint32_t, VkDescriptorSetLayout> VKFS::BindlessTable::matchSets(const std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> &sets) {
+    std::map<uint32_t, VkDescriptorSetLayout> matched;
+
+    for (auto& set : sets) {
+        bool runtimeArray = false;
+        for (auto& binding : set.second) {
+            runtimeArray |= binding.descriptorCount == 0;
+        }
+
+        if (!runtimeArray) {
+            continue;
+        }
+
+        for (auto& binding : set.second) {
+            std::string where = "set " + std::to_string(set.first) + " binding " + std::to_string(binding.binding);
+
+            bool fits = (binding.binding == TEXTURE_BINDING && binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER && binding.descriptorCount <= textureCapacity) ||
+                        (binding.binding == STORAGE_BUFFER_BINDING && binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && binding.descriptorCount <= storageBufferCapacity);
+
+            if (!fits) {
+                throw std::runtime_error("[VKFS] Shaders use " + where + " in a runtime array set, which does not match the bindless table!");
+            }
+        }
+
+        matched[set.first] = descriptorSetLayout;
+    }
+
+    return matched;
+}
+
+VkDescriptorSetLayout VKFS::BindlessTable::getDescriptorSetLayout() {
+    return this->descriptorSetLayout;
+}
+
+VkDescriptorSet VKFS::BindlessTable::getSet() {
+    return this->descriptorSet;
+}
+
+uint32_t VKFS::BindlessTable::getTextureCapacity() {
+    return this->textureCapacity;
+}
+
+uint32_t VKFS::BindlessTable::getStorageBufferCapacity() {
+    return this->storageBufferCapacity;
+}
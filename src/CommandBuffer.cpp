@@ -3,7 +3,7 @@
 #include "../include/VKFS/CommandBuffer.h"
 
 VKFS::CommandBuffer::CommandBuffer(VKFS::Device *device) : device(device) {
-    commandBuffers.resize(2);
+    commandBuffers.resize(device->getFramesInFlight());
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -16,7 +16,7 @@ VKFS::CommandBuffer::CommandBuffer(VKFS::Device *device) : device(device) {
     }
 
 
-    computeBuffers.resize(2);
+    computeBuffers.resize(device->getFramesInFlight());
 
 
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
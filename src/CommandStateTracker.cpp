@@ -0,0 +1,195 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/CommandStateTracker.h"
+
+void VKFS::CommandStateTracker::begin(VkCommandBuffer commandBuffer) {
+    this->commandBuffer = commandBuffer;
+    invalidate();
+
+    issued = 0;
+    elided = 0;
+}
+
+void VKFS::CommandStateTracker::invalidate() {
+    graphicsPipeline = VK_NULL_HANDLE;
+    computePipeline = VK_NULL_HANDLE;
+    viewportSet = false;
+    scissorSet = false;
+    vertexBuffers.clear();
+    indexBuffer = VK_NULL_HANDLE;
+    graphicsSets = __BoundDescriptorSets();
+    computeSets = __BoundDescriptorSets();
+}
+
+void VKFS::CommandStateTracker::bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline) {
+    VkPipeline& bound = bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? computePipeline : graphicsPipeline;
+
+    if (bound == pipeline) {
+        elided++;
+        return;
+    }
+
+    vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+    bound = pipeline;
+    issued++;
+}
+
+void VKFS::CommandStateTracker::setViewport(const VkViewport &viewport) {
+    if (viewportSet && memcmp(&this->viewport, &viewport, sizeof(VkViewport)) == 0) {
+        elided++;
+        return;
+    }
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    this->viewport = viewport;
+    viewportSet = true;
+    issued++;
+}
+
+void VKFS::CommandStateTracker::setScissor(const VkRect2D &scissor) {
+    if (scissorSet && memcmp(&this->scissor, &scissor, sizeof(VkRect2D)) == 0) {
+        elided++;
+        return;
+    }
+
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    this->scissor = scissor;
+    scissorSet = true;
+    issued++;
+}
+
+void VKFS::CommandStateTracker::bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset) {
+    if (binding < vertexBuffers.size() && vertexBuffers[binding].first == buffer && vertexBuffers[binding].second == offset) {
+        elided++;
+        return;
+    }
+
+    vkCmdBindVertexBuffers(commandBuffer, binding, 1, &buffer, &offset);
+
+    if (binding >= vertexBuffers.size()) {
+        vertexBuffers.resize(binding + 1, {VK_NULL_HANDLE, 0});
+    }
+    vertexBuffers[binding] = {buffer, offset};
+    issued++;
+}
+
+void VKFS::CommandStateTracker::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+    if (indexBuffer == buffer && indexOffset == offset && this->indexType == indexType) {
+        elided++;
+        return;
+    }
+
+    vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+    indexBuffer = buffer;
+    indexOffset = offset;
+    this->indexType = indexType;
+    issued++;
+}
+
+void VKFS::CommandStateTracker::bindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet,
+                                                   const std::vector<VkDescriptorSet> &sets, const std::vector<uint32_t> &dynamicOffsets) {
+    if (sets.empty()) {
+        return;
+    }
+
+    __BoundDescriptorSets& bound = bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? computeSets : graphicsSets;
+
+    bool same = bound.layout == layout && firstSet + sets.size() <= bound.sets.size();
+    for (size_t i = 0; same && i < sets.size(); i++) {
+        same = bound.sets[firstSet + i] == sets[i];
+    }
+
+    if (same && !dynamicOffsets.empty()) {
+        same = bound.lastFirstSet == firstSet && bound.lastSetCount == sets.size() && bound.lastDynamicOffsets == dynamicOffsets;
+    }
+
+    if (same) {
+        elided++;
+        return;
+    }
+
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, static_cast<uint32_t>(sets.size()), sets.data(),
+                            static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+
+    // A different layout may disturb every other set, so only the ones just bound are known
+    if (bound.layout != layout) {
+        bound.sets.clear();
+        bound.layout = layout;
+    }
+
+    if (bound.sets.size() < firstSet + sets.size()) {
+        bound.sets.resize(firstSet + sets.size(), VK_NULL_HANDLE);
+    }
+
+    for (size_t i = 0; i < sets.size(); i++) {
+        bound.sets[firstSet + i] = sets[i];
+    }
+
+    bound.lastFirstSet = firstSet;
+    bound.lastSetCount = static_cast<uint32_t>(sets.size());
+    bound.lastDynamicOffsets = dynamicOffsets;
+    issued++;
+}
+
+void VKFS::CommandStateTracker::bindDrawState(VkPipelineLayout layout, VkPipeline pipeline, VkExtent2D viewportSize,
+                                              VkBuffer vertexBuffer, VkBuffer indexBuffer, VkIndexType indexType,
+                                              const std::vector<VkDescriptorSet> &sets, const std::vector<uint32_t> &dynamicOffsets,
+                                              VkShaderStageFlags pushConstantsStages, const void *pushConstants, uint32_t pushConstantsSize) {
+    bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float) viewportSize.width;
+    viewport.height = (float) viewportSize.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    setViewport(viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = viewportSize;
+    setScissor(scissor);
+
+    bindVertexBuffer(0, vertexBuffer, 0);
+    bindIndexBuffer(indexBuffer, 0, indexType);
+    bindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, sets, dynamicOffsets);
+
+    // Push constants are not tracked, the caller's values may change between draws
+    if (pushConstants != nullptr) {
+        vkCmdPushConstants(commandBuffer, layout, pushConstantsStages, 0, pushConstantsSize, pushConstants);
+    }
+}
+
+VkCommandBuffer VKFS::CommandStateTracker::getCommandBuffer() {
+    return this->commandBuffer;
+}
+
+uint64_t VKFS::CommandStateTracker::getIssuedCount() {
+    return this->issued;
+}
+
+uint64_t VKFS::CommandStateTracker::getElidedCount() {
+    return this->elided;
+}
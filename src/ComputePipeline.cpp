@@ -3,51 +3,159 @@
 //
 
 #include "../include/VKFS/ComputePipeline.h"
+#include "../include/VKFS/PipelineStatistics.h"
+#include "../include/VKFS/TraceRecorder.h"
 
 VKFS::ComputePipeline::ComputePipeline(VKFS::Device *device, VKFS::ShaderModule *computeShader,
-                                       std::vector<VKFS::Descriptor *> descriptors) : device(device), descriptors(descriptors) {
+                                       std::vector<VKFS::Descriptor *> descriptors, bool deferBuild) : device(device), computeShader(computeShader), descriptors(descriptors) {
+    if (!deferBuild) {
+        build();
+    }
+}
+
+void VKFS::ComputePipeline::build() {
+    TraceSpan span(device, "ComputePipeline::build");
+
     VkPipelineShaderStageCreateInfo computeShaderStageInfo{};
     computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
     computeShaderStageInfo.module = computeShader->getShaderModule();
-    computeShaderStageInfo.pName = "main";
+    computeShaderStageInfo.pName = computeShader->getReflection().getEntryPoint().c_str();
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    std::vector<const ShaderReflection*> reflections = {&computeShader->getReflection()};
+
+    if (descriptors.empty()) {
+        // No descriptors given, derive minimal set layouts from the shader. Sets with runtime arrays use the bindless table
+        auto mergedBindings = ShaderReflection::mergeBindings(reflections);
+
+        std::map<uint32_t, VkDescriptorSetLayout> bindlessLayouts;
+        if (device->isBindless()) {
+            bindlessLayouts = device->getBindlessTable()->matchSets(mergedBindings);
+        }
+
+        setLayouts = ShaderReflection::createSetLayouts(device->getDevice(), mergedBindings, bindlessLayouts);
+
+        std::vector<VkDescriptorSetLayout> reflectedLayouts = setLayouts;
+        clearQueue.push_function([=] () {
+            for (uint32_t set = 0; set < reflectedLayouts.size(); set++) {
+                if (bindlessLayouts.find(set) == bindlessLayouts.end()) {
+                    vkDestroyDescriptorSetLayout(device->getDevice(), reflectedLayouts[set], nullptr);
+                }
+            }
+        });
+    } else {
+        std::vector<std::vector<VkDescriptorSetLayoutBinding>> providedBindings;
 
-    std::vector<VkDescriptorSetLayout> lays;
+        for (VKFS::Descriptor* desc : descriptors) {
+            setLayouts.push_back(desc->getDescriptorSetLayout());
+            providedBindings.push_back(desc->getBindings());
+        }
 
-    for (VKFS::Descriptor* desc : descriptors) {
-        lays.push_back(desc->getDescriptorSetLayout());
+        ShaderReflection::validateSetLayouts(reflections, providedBindings);
     }
 
-    pipelineLayoutInfo.setLayoutCount = lays.size();
-    pipelineLayoutInfo.pSetLayouts = lays.data();
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = setLayouts.size();
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+
+    VkPushConstantRange pushConsts = ShaderReflection::mergePushConstants(reflections);
+    if (pushConsts.size > 0) {
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConsts;
+    }
 
     if (vkCreatePipelineLayout(device->getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to create compute pipeline layout!");
     }
 
+    clearQueue.push_function([=] () {
+        vkDestroyPipelineLayout(device->getDevice(), pipelineLayout, nullptr);
+    });
+
     VkComputePipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
     pipelineInfo.layout = pipelineLayout;
     pipelineInfo.stage = computeShaderStageInfo;
 
-    if (vkCreateComputePipelines(device->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+    if (vkCreateComputePipelines(device->getDevice(), device->getPipelineCache()->getPipelineCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to create compute pipeline!");
     }
+
+    clearQueue.push_function([=] () {
+        vkDestroyPipeline(device->getDevice(), pipeline, nullptr);
+    });
+
+    ready = true;
+}
+
+VKFS::ComputePipeline::~ComputePipeline() {
+    clearQueue.flush();
+}
+
+bool VKFS::ComputePipeline::isReady() {
+    return ready;
+}
+
+VkPipelineLayout VKFS::ComputePipeline::getPipelineLayout() {
+    return pipelineLayout;
+}
+
+const std::vector<VkDescriptorSetLayout> &VKFS::ComputePipeline::getDescriptorSetLayouts() {
+    return setLayouts;
+}
+
+const uint32_t *VKFS::ComputePipeline::getLocalSize() {
+    return computeShader->getReflection().getLocalSize();
 }
 
 void VKFS::ComputePipeline::dispatch(VKFS::Synchronization *sync, int workingGroupCountX, int workingGroupCountY,
-                                     int workingGroupCountZ) {
-    vkCmdBindPipeline(sync->getComputeCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+                                     int workingGroupCountZ, const std::vector<uint32_t>& dynamicOffsets) {
+    CommandStateTracker* state = sync->getComputeStateTracker();
+    state->bindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+    // Push descriptors are pushed by the caller, so the sets around them are bound in runs
+    std::vector<VkDescriptorSet> sets;
+    uint32_t firstSet = 0;
+    size_t offsetsBegin = 0, offsetsEnd = 0;
 
-    for (int i = 0; i < descriptors.size(); i++) {
+    for (size_t i = 0; i <= descriptors.size(); i++) {
+        if (i < descriptors.size() && !descriptors[i]->isPushDescriptor()) {
+            sets.push_back(descriptors[i]->getSet(sync));
+            offsetsEnd += descriptors[i]->getDynamicOffsetCount();
+            continue;
+        }
 
-        VkDescriptorSet set = descriptors[i]->getSet(sync);
+        if (!sets.empty()) {
+            if (offsetsEnd > dynamicOffsets.size()) {
+                throw std::runtime_error("[VKFS] Not enough dynamic offsets for the compute pipeline's descriptors!");
+            }
 
-        vkCmdBindDescriptorSets(sync->getComputeCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, i, 1, &set, 0, nullptr);
+            state->bindDescriptorSets(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, firstSet, sets,
+                                      std::vector<uint32_t>(dynamicOffsets.begin() + offsetsBegin, dynamicOffsets.begin() + offsetsEnd));
+        }
+
+        sets.clear();
+        firstSet = static_cast<uint32_t>(i + 1);
+        offsetsBegin = offsetsEnd;
+    }
+
+    PipelineStatistics* statistics = sync->getPipelineStatistics();
+    if (statistics != nullptr) {
+        statistics->beginPass(name, PROFILE_COMPUTE);
     }
 
     vkCmdDispatch(sync->getComputeCommandBuffer(), workingGroupCountX, workingGroupCountY, workingGroupCountZ);
+
+    if (statistics != nullptr) {
+        statistics->endPass(PROFILE_COMPUTE);
+    }
+}
+
+void VKFS::ComputePipeline::setName(const std::string &name) {
+    this->name = name;
+}
+
+std::string VKFS::ComputePipeline::getName() {
+    return this->name;
 }
@@ -0,0 +1,125 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/DeletionQueue.h"
+#include "../include/VKFS/Device.h"
+
+VKFS::DeletionQueue::DeletionQueue(VKFS::Device *device) : device(device) {}
+
+VKFS::DeletionQueue::~DeletionQueue() {
+    flush();
+}
+
+void VKFS::DeletionQueue::push(std::function<void()> &&function) {
+    UploadTicket ticket = device->getUploadContext()->getCurrentTicket();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        deletions.push_back({lastSubmission, ticket, std::move(function)});
+    }
+
+    // Runs it right away when nothing that could use the resource is in flight
+    collect();
+}
+
+void VKFS::DeletionQueue::collect() {
+    std::vector<std::function<void()>> ready;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (auto it = inFlight.begin(); it != inFlight.end();) {
+            if (vkGetFenceStatus(device->getDevice(), it->second) == VK_SUCCESS) {
+                it = inFlight.erase(it);
+            } else {
+                it++;
+            }
+        }
+
+        uint64_t completed = completedLocked();
+        UploadContext* uploads = device->getUploadContext();
+
+        // Deletions are queued in submission order, so the first one that isn't ready stops the scan
+        while (!deletions.empty() && deletions.front().submission <= completed && uploads->isComplete(deletions.front().uploadTicket)) {
+            ready.push_back(std::move(deletions.front().function));
+            deletions.pop_front();
+        }
+    }
+
+    // Outside the lock, a deletion may free memory through the allocator or push another deletion
+    for (auto& function : ready) {
+        function();
+    }
+}
+
+void VKFS::DeletionQueue::flush() {
+    device->getUploadContext()->waitIdle();
+    vkDeviceWaitIdle(device->getDevice());
+
+    std::deque<__Deletion> remaining;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight.clear();
+        remaining.swap(deletions);
+    }
+
+    for (auto& deletion : remaining) {
+        deletion.function();
+    }
+}
+
+uint64_t VKFS::DeletionQueue::beginSubmission(VkFence fence) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    lastSubmission++;
+    inFlight[lastSubmission] = fence;
+
+    return lastSubmission;
+}
+
+void VKFS::DeletionQueue::completeSubmission(uint64_t submission) {
+    std::lock_guard<std::mutex> lock(mutex);
+    inFlight.erase(submission);
+}
+
+uint64_t VKFS::DeletionQueue::getLastSubmission() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastSubmission;
+}
+
+uint64_t VKFS::DeletionQueue::getCompletedSubmission() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return completedLocked();
+}
+
+size_t VKFS::DeletionQueue::getPendingCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return deletions.size();
+}
+
+uint64_t VKFS::DeletionQueue::completedLocked() {
+    if (inFlight.empty()) return lastSubmission;
+
+    return inFlight.begin()->first - 1;
+}
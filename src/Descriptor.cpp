@@ -22,7 +22,14 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "../include/VKFS/Descriptor.h"
 
-VKFS::Descriptor::Descriptor(VKFS::Device *device, VkDescriptorType type, VkShaderStageFlagBits shaderStage) : device(device) {
+// Storage buffers are read and written by shaders, so uploads into them are handed to these stages
+static const VkAccessFlags storageBufferAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+static const VkPipelineStageFlags storageBufferStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+VKFS::Descriptor::Descriptor(VKFS::Device *device) : device(device) {}
+
+VKFS::Descriptor::Descriptor(VKFS::Device *device, VkDescriptorType type, VkShaderStageFlagBits shaderStage) : device(device), legacyStage(shaderStage) {
 
     // Create bindings
 
@@ -33,241 +40,670 @@ VKFS::Descriptor::Descriptor(VKFS::Device *device, VkDescriptorType type, VkShad
     layoutBinding.pImmutableSamplers = nullptr;
     layoutBinding.stageFlags = shaderStage;
 
-    std::array<VkDescriptorSetLayoutBinding, 1> bindings = {layoutBinding};
+    layoutBindings = {layoutBinding};
+    createLayout();
+}
+
+void VKFS::Descriptor::createLayout(VkDescriptorSetLayoutCreateFlags flags) {
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-    layoutInfo.pBindings = bindings.data();
+    layoutInfo.flags = flags;
+    layoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+    layoutInfo.pBindings = layoutBindings.data();
 
     if (vkCreateDescriptorSetLayout(device->getDevice(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to create descriptor set layout!");
     }
 
+    // The clear functions run with the object alive and hand the handles to the deletion queue
     clearQueue.push_function([=] () {
-        vkDestroyDescriptorSetLayout(device->getDevice(), descriptorSetLayout, nullptr);
+        Device* d = device;
+        VkDescriptorSetLayout layout = descriptorSetLayout;
+
+        device->getDeletionQueue()->push([=] () {
+            d->getDescriptorAllocator()->releaseLayout(layout);
+            vkDestroyDescriptorSetLayout(d->getDevice(), layout, nullptr);
+        });
     });
 
-    // Create pool
+    // Templates are created on first use and must go before the layout
+    clearQueue.push_function([=] () {
+        Device* d = device;
+        std::vector<VkDescriptorUpdateTemplate> templates;
 
-    std::array<VkDescriptorPoolSize, 1> poolSizes{};
-    poolSizes[0].type = type;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(2);
+        if (updateTemplate != VK_NULL_HANDLE) {
+            templates.push_back(updateTemplate);
+        }
 
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(2);
+        for (auto& pushTemplate : pushTemplates) {
+            templates.push_back(pushTemplate.second);
+        }
 
-    if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to create descriptor pool!");
-    }
+        device->getDeletionQueue()->push([=] () {
+            for (auto handle : templates) {
+                vkDestroyDescriptorUpdateTemplate(d->getDevice(), handle, nullptr);
+            }
+        });
+    });
 
-    clearQueue.push_function([=] () {
-        vkDestroyDescriptorPool(device->getDevice(), descriptorPool, nullptr);
+    // Template data packs every binding in binding order
+    std::vector<VkDescriptorSetLayoutBinding> sorted = layoutBindings;
+    std::sort(sorted.begin(), sorted.end(), [] (const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+        return a.binding < b.binding;
     });
+
+    templateEntries.clear();
+    templateDataSize = 0;
+
+    for (auto& binding : sorted) {
+        bool buffer = binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ||
+                      binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+        VkDescriptorUpdateTemplateEntry entry{};
+        entry.dstBinding = binding.binding;
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = binding.descriptorCount;
+        entry.descriptorType = binding.descriptorType;
+        entry.offset = templateDataSize;
+        entry.stride = buffer ? sizeof(VkDescriptorBufferInfo) : sizeof(VkDescriptorImageInfo);
+
+        templateEntries.push_back(entry);
+        templateDataSize += entry.stride * entry.descriptorCount;
+    }
+}
+
+VkDescriptorUpdateTemplate VKFS::Descriptor::createTemplate(VkDescriptorUpdateTemplateType type, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set) {
+    if (!device->supportsUpdateTemplates()) {
+        throw std::runtime_error("[VKFS] Descriptor update templates need Vulkan 1.1 on both the instance and the device!");
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+    templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.size());
+    templateInfo.pDescriptorUpdateEntries = templateEntries.data();
+    templateInfo.templateType = type;
+    templateInfo.descriptorSetLayout = descriptorSetLayout;
+    templateInfo.pipelineBindPoint = bindPoint;
+    templateInfo.pipelineLayout = layout;
+    templateInfo.set = set;
+
+    VkDescriptorUpdateTemplate updateTemplate;
+    if (vkCreateDescriptorUpdateTemplate(device->getDevice(), &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to create descriptor update template!");
+    }
+
+    return updateTemplate;
 }
 
 VkDescriptorSetLayout VKFS::Descriptor::getDescriptorSetLayout() {
     return this->descriptorSetLayout;
 }
 
-VkDescriptorPool VKFS::Descriptor::getDescriptorPool() {
-    return this->descriptorPool;
+const std::vector<VkDescriptorSetLayoutBinding> &VKFS::Descriptor::getBindings() {
+    return this->layoutBindings;
 }
 
-void VKFS::Descriptor::createUBOSet(unsigned int sizeOf) {
-    VkDeviceSize bufferSize = sizeOf;
+VKFS::Descriptor* VKFS::Descriptor::addBinding(VKFS::__DescriptorBinding binding) {
+    if (built) {
+        throw std::runtime_error("[VKFS] Cannot add bindings to a descriptor that is already built!");
+    }
+
+    for (auto& existing : bindings) {
+        if (existing.layoutBinding.binding == binding.layoutBinding.binding) {
+            throw std::runtime_error("[VKFS] Descriptor binding " + std::to_string(binding.layoutBinding.binding) + " is declared twice!");
+        }
+    }
+
+    bindings.push_back(binding);
+    return this;
+}
+
+VKFS::__DescriptorBinding &VKFS::Descriptor::findBinding(uint32_t binding) {
+    for (auto& existing : bindings) {
+        if (existing.layoutBinding.binding == binding) {
+            return existing;
+        }
+    }
+
+    throw std::runtime_error("[VKFS] Descriptor has no binding " + std::to_string(binding) + "!");
+}
+
+VKFS::Descriptor* VKFS::Descriptor::addUniformBuffer(uint32_t binding, VkDeviceSize size, VkShaderStageFlags stages) {
+    __DescriptorBinding newBinding{};
+    newBinding.layoutBinding = {binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, stages, nullptr};
+    newBinding.bufferSize = size;
+    newBinding.bufferRange = size;
+    newBinding.bufferUsage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+    return addBinding(newBinding);
+}
+
+VKFS::Descriptor* VKFS::Descriptor::addStorageBuffer(uint32_t binding, VkDeviceSize elementSize, uint32_t elementCount, VkShaderStageFlags stages, StorageBufferFlags flags) {
+    if (elementSize == 0 || elementCount == 0) {
+        throw std::runtime_error("[VKFS] Storage buffer binding " + std::to_string(binding) + " needs a non-zero element size and count!");
+    }
+
+    __DescriptorBinding newBinding{};
+    newBinding.layoutBinding = {binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stages, nullptr};
+    newBinding.bufferSize = elementSize * elementCount;
+    newBinding.bufferRange = newBinding.bufferSize;
+    newBinding.elementCount = elementCount;
+    newBinding.storageFlags = flags;
+    newBinding.bufferUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    // Staged writes and growth copy through transfer commands
+    if (flags & STORAGE_BUFFER_DEVICE_LOCAL) {
+        newBinding.bufferUsage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    return addBinding(newBinding);
+}
+
+VKFS::Descriptor* VKFS::Descriptor::addDynamicUniformBuffer(uint32_t binding, VkDeviceSize elementSize, VkShaderStageFlags stages, uint32_t maxElements) {
+    return addDynamicBuffer(binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, elementSize, stages, maxElements);
+}
+
+VKFS::Descriptor* VKFS::Descriptor::addDynamicStorageBuffer(uint32_t binding, VkDeviceSize elementSize, VkShaderStageFlags stages, uint32_t maxElements) {
+    return addDynamicBuffer(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, elementSize, stages, maxElements);
+}
+
+VKFS::Descriptor* VKFS::Descriptor::addDynamicBuffer(uint32_t binding, VkDescriptorType type, VkDeviceSize elementSize, VkShaderStageFlags stages, uint32_t maxElements) {
+    if (elementSize == 0 || maxElements == 0) {
+        throw std::runtime_error("[VKFS] Dynamic buffer binding " + std::to_string(binding) + " needs a non-zero element size and count!");
+    }
 
-    uniformBuffers.resize(2);
-    uniformBuffersMemory.resize(2);
-    uniformBuffersMapped.resize(2);
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(device->getPhysicalDevice(), &properties);
 
-    for (size_t i = 0; i < 2; i++) {
-        device->createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
-        vkMapMemory(device->getDevice(), uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+    // Dynamic offsets must be multiples of the device's minimum offset alignment
+    bool uniform = type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    VkDeviceSize alignment = uniform ? properties.limits.minUniformBufferOffsetAlignment : properties.limits.minStorageBufferOffsetAlignment;
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+
+    __DescriptorBinding newBinding{};
+    newBinding.layoutBinding = {binding, type, 1, stages, nullptr};
+    newBinding.stride = (elementSize + alignment - 1) / alignment * alignment;
+    newBinding.bufferSize = newBinding.stride * maxElements;
+    newBinding.bufferRange = elementSize;
+    newBinding.bufferUsage = uniform ? VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT : VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    return addBinding(newBinding);
+}
+
+VKFS::Descriptor* VKFS::Descriptor::addSampler(uint32_t binding, VkDescriptorImageInfo imageInfo, VkShaderStageFlags stages) {
+    return addSamplerArray(binding, {imageInfo}, stages);
+}
+
+VKFS::Descriptor* VKFS::Descriptor::addSamplerArray(uint32_t binding, const std::vector<VkDescriptorImageInfo> &imageInfos, VkShaderStageFlags stages) {
+    if (imageInfos.empty()) {
+        throw std::runtime_error("[VKFS] Sampler array binding " + std::to_string(binding) + " has no images!");
+    }
+
+    __DescriptorBinding newBinding{};
+    newBinding.layoutBinding = {binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(imageInfos.size()), stages, nullptr};
+    newBinding.imageInfos = imageInfos;
+
+    return addBinding(newBinding);
+}
+
+VKFS::Descriptor* VKFS::Descriptor::addStorageImage(uint32_t binding, VkDescriptorImageInfo imageInfo, VkShaderStageFlags stages) {
+    __DescriptorBinding newBinding{};
+    newBinding.layoutBinding = {binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, stages, nullptr};
+    newBinding.imageInfos = {imageInfo};
+
+    return addBinding(newBinding);
+}
+
+VKFS::Descriptor* VKFS::Descriptor::addExternalBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages, uint32_t count) {
+    __DescriptorBinding newBinding{};
+    newBinding.layoutBinding = {binding, type, count, stages, nullptr};
+
+    return addBinding(newBinding);
+}
+
+void VKFS::Descriptor::build() {
+    if (built) {
+        throw std::runtime_error("[VKFS] Descriptor is already built!");
+    }
+
+    if (bindings.empty()) {
+        throw std::runtime_error("[VKFS] Cannot build a descriptor without bindings!");
+    }
+
+    built = true;
+
+    // Descriptors created with the single binding constructor already own a layout
+
+    if (descriptorSetLayout == VK_NULL_HANDLE) {
+        layoutBindings.clear();
+        for (auto& binding : bindings) {
+            layoutBindings.push_back(binding.layoutBinding);
+        }
+
+        createLayout();
+    }
+
+    buildResources(true);
+}
+
+void VKFS::Descriptor::buildPushDescriptor() {
+    if (built || descriptorSetLayout != VK_NULL_HANDLE) {
+        throw std::runtime_error("[VKFS] Descriptor is already built!");
+    }
+
+    if (bindings.empty()) {
+        throw std::runtime_error("[VKFS] Cannot build a descriptor without bindings!");
+    }
+
+    cmdPushDescriptorSet = (PFN_vkCmdPushDescriptorSetKHR) vkGetDeviceProcAddr(device->getDevice(), "vkCmdPushDescriptorSetKHR");
+    cmdPushDescriptorSetWithTemplate = (PFN_vkCmdPushDescriptorSetWithTemplateKHR) vkGetDeviceProcAddr(device->getDevice(), "vkCmdPushDescriptorSetWithTemplateKHR");
+
+    if (cmdPushDescriptorSet == nullptr) {
+        throw std::runtime_error("[VKFS] Push descriptors need the VK_KHR_push_descriptor device extension!");
+    }
+
+    built = true;
+    pushDescriptor = true;
+
+    for (auto& binding : bindings) {
+        if (binding.stride != 0) {
+            throw std::runtime_error("[VKFS] Push descriptors cannot contain dynamic buffers!");
+        }
+
+        layoutBindings.push_back(binding.layoutBinding);
+    }
+
+    createLayout(VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
+    buildResources(false);
+}
+
+void VKFS::Descriptor::buildResources(bool allocateSets) {
+    // Create buffers
+
+    for (auto& binding : bindings) {
+        if (binding.bufferSize != 0) {
+            createBindingBuffers(binding);
+        }
     }
 
     clearQueue.push_function([=] () {
-        for (size_t i = 0; i < 2; i++) {
-            vkFreeMemory(device->getDevice(), uniformBuffersMemory[i], nullptr);
-            vkDestroyBuffer(device->getDevice(), uniformBuffers[i], nullptr);
+        Device* d = device;
+        std::vector<VkBuffer> buffers;
+        std::vector<Allocation> allocations;
+
+        for (auto& binding : bindings) {
+            buffers.insert(buffers.end(), binding.buffers.begin(), binding.buffers.end());
+            allocations.insert(allocations.end(), binding.allocations.begin(), binding.allocations.end());
         }
+
+        device->getDeletionQueue()->push([=] () mutable {
+            for (size_t i = 0; i < buffers.size(); i++) {
+                d->destroyBuffer(buffers[i], allocations[i]);
+            }
+        });
     });
 
+    if (!allocateSets) {
+        return;
+    }
 
-    std::vector<VkDescriptorSetLayout> layouts(2, descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(2);
-    allocInfo.pSetLayouts = layouts.data();
+    // Allocate sets from the device's shared pools
 
-    descriptorSets.resize(2);
-    if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to allocate descriptor sets!");
+    descriptorSets.resize(device->getFramesInFlight());
+    for (size_t i = 0; i < device->getFramesInFlight(); i++) {
+        descriptorSets[i] = device->getDescriptorAllocator()->allocate(descriptorSetLayout);
     }
 
     clearQueue.push_function([=] () {
-        vkFreeDescriptorSets(device->getDevice(), descriptorPool, descriptorSets.size(), descriptorSets.data());
+        Device* d = device;
+        std::vector<DescriptorAllocation> sets = descriptorSets;
+
+        device->getDeletionQueue()->push([=] () {
+            for (auto& set : sets) {
+                d->getDescriptorAllocator()->free(set);
+            }
+        });
     });
 
-    for (size_t i = 0; i < 2; i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeOf;
+    writeSets();
+}
+
+void VKFS::Descriptor::createBindingBuffers(VKFS::__DescriptorBinding &binding) {
+    size_t count = (binding.storageFlags & STORAGE_BUFFER_SINGLE) ? 1 : device->getFramesInFlight();
+
+    VkMemoryPropertyFlags properties = (binding.storageFlags & STORAGE_BUFFER_DEVICE_LOCAL) ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT :
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
-        std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+    binding.buffers.resize(count);
+    binding.allocations.resize(count);
 
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
+    for (size_t i = 0; i < count; i++) {
+        device->createBuffer(binding.bufferSize, binding.bufferUsage, properties, binding.buffers[i], binding.allocations[i], MEMORY_BUFFER,
+                             "Descriptor binding " + std::to_string(binding.layoutBinding.binding));
+    }
+}
+
+void VKFS::Descriptor::writeSets(VKFS::__DescriptorBinding *only) {
+    // Write every binding of every frame's set in a single update
+
+    std::vector<VkDescriptorBufferInfo> bufferInfos;
+    bufferInfos.reserve(bindings.size() * device->getFramesInFlight());
+
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+    for (size_t i = 0; i < device->getFramesInFlight(); i++) {
+        for (auto& binding : bindings) {
+            if (only != nullptr && only != &binding) {
+                continue;
+            }
+
+            // External bindings are written by the caller
+            if (binding.bufferSize == 0 && binding.imageInfos.empty()) {
+                continue;
+            }
+
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = descriptorSets[i].set;
+            write.dstBinding = binding.layoutBinding.binding;
+            write.dstArrayElement = 0;
+            write.descriptorType = binding.layoutBinding.descriptorType;
+            write.descriptorCount = binding.layoutBinding.descriptorCount;
+
+            if (binding.bufferSize != 0) {
+                VkDescriptorBufferInfo bufferInfo{};
+                bufferInfo.buffer = binding.buffers[std::min(i, binding.buffers.size() - 1)];
+                bufferInfo.offset = 0;
+                bufferInfo.range = binding.bufferRange;
+
+                bufferInfos.push_back(bufferInfo);
+                write.pBufferInfo = &bufferInfos.back();
+            } else {
+                write.pImageInfo = binding.imageInfos.data();
+            }
+
+            descriptorWrites.push_back(write);
+        }
+    }
 
+    if (!descriptorWrites.empty()) {
         vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
 }
 
+void VKFS::Descriptor::createUBOSet(unsigned int sizeOf) {
+    addUniformBuffer(0, sizeOf, legacyStage);
+    build();
+}
+
+void VKFS::Descriptor::createStorageBufferSet(unsigned int sizeOf, uint32_t elementCount, StorageBufferFlags flags) {
+    addStorageBuffer(0, sizeOf, elementCount, legacyStage, flags);
+    build();
+}
+
 void VKFS::Descriptor::createSamplerSet(VkDescriptorImageInfo sampler) {
-    std::vector<VkDescriptorSetLayout> layouts(2, descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(2);
-    allocInfo.pSetLayouts = layouts.data();
+    sampler.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    descriptorSets.resize(2);
-    if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to allocate descriptor sets!");
-    }
+    addSampler(0, sampler, legacyStage);
+    build();
+}
 
-    clearQueue.push_function([=] () {
-        vkFreeDescriptorSets(device->getDevice(), descriptorPool, descriptorSets.size(), descriptorSets.data());
-    });
+void VKFS::Descriptor::createStorageImageSet(VkDescriptorImageInfo imageInfo) {
+    // Set the image layout to the desired layout (e.g., VK_IMAGE_LAYOUT_GENERAL)
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    addStorageImage(0, imageInfo, legacyStage);
+    build();
+}
 
-    for (size_t i = 0; i < 2; i++) {
-        sampler.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        sampler.imageView = sampler.imageView;
-        sampler.sampler = sampler.sampler;
+void *VKFS::Descriptor::getBufferForUpdate(VKFS::Synchronization *sync) {
+    for (auto& binding : bindings) {
+        if (binding.bufferSize != 0) {
+            return getBufferForUpdate(sync, binding.layoutBinding.binding);
+        }
+    }
 
-        std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+    throw std::runtime_error("[VKFS] Descriptor has no buffer bindings!");
+}
 
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pImageInfo = &sampler;
+void *VKFS::Descriptor::getBufferForUpdate(VKFS::Synchronization *sync, uint32_t binding) {
+    auto& found = findBinding(binding);
+    if (found.bufferSize == 0) {
+        throw std::runtime_error("[VKFS] Descriptor binding " + std::to_string(binding) + " is not a buffer!");
+    }
 
-        vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    if (found.storageFlags & STORAGE_BUFFER_DEVICE_LOCAL) {
+        throw std::runtime_error("[VKFS] Device-local storage buffer binding " + std::to_string(binding) + " can only be written with updateStorageBuffer()!");
     }
+
+    return found.allocations[found.allocations.size() > 1 ? sync->getCurrentFrame() : 0].mapped;
 }
 
-void *VKFS::Descriptor::getBufferForUpdate(VKFS::Synchronization *sync) {
-    return this->uniformBuffersMapped[sync->getCurrentFrame()];
+uint32_t VKFS::Descriptor::pushDynamic(VKFS::Synchronization *sync, uint32_t binding, const void *data, VkDeviceSize size) {
+    auto& found = findBinding(binding);
+    if (found.stride == 0) {
+        throw std::runtime_error("[VKFS] Descriptor binding " + std::to_string(binding) + " is not a dynamic buffer!");
+    }
+
+    if (size > found.bufferRange) {
+        throw std::runtime_error("[VKFS] Data pushed to dynamic binding " + std::to_string(binding) + " is larger than its element size!");
+    }
+
+    // The caller waited for this frame slot's fence, so everything pushed into it last time has been consumed
+    if (found.frameNumber != sync->getFrameNumber()) {
+        found.head = 0;
+        found.frameNumber = sync->getFrameNumber();
+    }
+
+    if (found.head + found.stride > found.bufferSize) {
+        throw std::runtime_error("[VKFS] Dynamic binding " + std::to_string(binding) + " is out of space for this frame!");
+    }
+
+    VkDeviceSize offset = found.head;
+    memcpy(static_cast<char*>(found.allocations[sync->getCurrentFrame()].mapped) + offset, data, size);
+    found.head += found.stride;
+
+    return static_cast<uint32_t>(offset);
 }
 
-VkDescriptorSet VKFS::Descriptor::getSet(VKFS::Synchronization *sync) {
-    return this->descriptorSets[sync->getCurrentFrame()];
+VKFS::UploadTicket VKFS::Descriptor::updateStorageBuffer(VKFS::Synchronization *sync, uint32_t binding, const void *data, VkDeviceSize size, VkDeviceSize offset) {
+    auto& found = findBinding(binding);
+    if (found.layoutBinding.descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || found.buffers.empty()) {
+        throw std::runtime_error("[VKFS] Descriptor binding " + std::to_string(binding) + " is not a built storage buffer!");
+    }
+
+    if (offset + size > found.bufferSize) {
+        throw std::runtime_error("[VKFS] Update of storage buffer binding " + std::to_string(binding) + " is out of bounds!");
+    }
+
+    // Per-frame buffers only update the copy of the frame being recorded
+    size_t index = 0;
+    if (found.buffers.size() > 1) {
+        if (sync == nullptr) {
+            throw std::runtime_error("[VKFS] Updating a per-frame storage buffer needs the Synchronization object!");
+        }
+
+        index = sync->getCurrentFrame();
+    }
+
+    if (!(found.storageFlags & STORAGE_BUFFER_DEVICE_LOCAL)) {
+        memcpy(static_cast<char*>(found.allocations[index].mapped) + offset, data, size);
+        return 0;
+    }
+
+    StagingAllocation staging = device->getStagingRing()->upload(data, size);
+
+    // Frames in flight may use a shared buffer, so the copy is recorded on the graphics queue after them
+    if (found.storageFlags & STORAGE_BUFFER_SINGLE) {
+        VkBufferCopy region{};
+        region.srcOffset = staging.offset;
+        region.dstOffset = offset;
+        region.size = size;
+
+        device->getUploadContext()->copyBuffer(staging.buffer, found.buffers[index], region, storageBufferAccess, storageBufferStages, true);
+        return device->getUploadContext()->getCurrentTicket();
+    }
+
+    return device->copyBuffer(staging.buffer, found.buffers[index], size, staging.offset, offset, storageBufferAccess, storageBufferStages);
 }
 
-void VKFS::Descriptor::createStorageBufferSet(unsigned int sizeOf) {
-    VkDeviceSize bufferSize = sizeOf * 1000;
+void VKFS::Descriptor::resizeStorageBuffer(uint32_t binding, uint32_t elementCount) {
+    auto& found = findBinding(binding);
+    if (found.layoutBinding.descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || found.buffers.empty()) {
+        throw std::runtime_error("[VKFS] Descriptor binding " + std::to_string(binding) + " is not a built storage buffer!");
+    }
+
+    VkDeviceSize elementSize = found.bufferSize / found.elementCount;
+    VkDeviceSize newSize = elementSize * elementCount;
+    VkDeviceSize copySize = std::min(found.bufferSize, newSize);
 
-    uniformBuffers.resize(2);
-    uniformBuffersMemory.resize(2);
-    uniformBuffersMapped.resize(2);
+    std::vector<VkBuffer> oldBuffers = found.buffers;
+    std::vector<Allocation> oldAllocations = found.allocations;
+
+    found.bufferSize = newSize;
+    found.bufferRange = newSize;
+    found.elementCount = elementCount;
+    createBindingBuffers(found);
+
+    if (!(found.storageFlags & STORAGE_BUFFER_DEVICE_LOCAL)) {
+        for (size_t i = 0; i < oldBuffers.size(); i++) {
+            memcpy(found.allocations[i].mapped, oldAllocations[i].mapped, copySize);
+        }
+    } else {
+        // Shaders write the old buffers on the graphics queue, so the copy is recorded there after them
+        VkBufferCopy region{};
+        region.size = copySize;
 
-    for (size_t i = 0; i < 2; i++) {
-        device->createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
-        vkMapMemory(device->getDevice(), uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+        for (size_t i = 0; i < oldBuffers.size(); i++) {
+            device->getUploadContext()->copyBuffer(oldBuffers[i], found.buffers[i], region, storageBufferAccess, storageBufferStages, true);
+        }
     }
 
-    clearQueue.push_function([=] () {
-        for (size_t i = 0; i < 2; i++) {
-            vkFreeMemory(device->getDevice(), uniformBuffersMemory[i], nullptr);
-            vkDestroyBuffer(device->getDevice(), uniformBuffers[i], nullptr);
+    // Frames in flight keep their sets, so the new buffers go into fresh sets and the old ones are retired together
+    VKFS::Device* d = device;
+    std::vector<DescriptorAllocation> oldSets = descriptorSets;
+
+    if (!descriptorSets.empty()) {
+        for (size_t i = 0; i < descriptorSets.size(); i++) {
+            descriptorSets[i] = device->getDescriptorAllocator()->allocate(descriptorSetLayout);
         }
-    });
 
-    std::vector<VkDescriptorSetLayout> layouts(2, descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(2);
-    allocInfo.pSetLayouts = layouts.data();
+        // External bindings are only known to the old sets
+        std::vector<VkCopyDescriptorSet> copies;
+        for (size_t i = 0; i < descriptorSets.size(); i++) {
+            for (auto& binding : bindings) {
+                if (binding.bufferSize != 0 || !binding.imageInfos.empty()) {
+                    continue;
+                }
+
+                VkCopyDescriptorSet copy{};
+                copy.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+                copy.srcSet = oldSets[i].set;
+                copy.srcBinding = binding.layoutBinding.binding;
+                copy.dstSet = descriptorSets[i].set;
+                copy.dstBinding = binding.layoutBinding.binding;
+                copy.descriptorCount = binding.layoutBinding.descriptorCount;
+
+                copies.push_back(copy);
+            }
+        }
 
-    descriptorSets.resize(2);
-    if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to allocate descriptor sets!");
+        if (!copies.empty()) {
+            vkUpdateDescriptorSets(device->getDevice(), 0, nullptr, static_cast<uint32_t>(copies.size()), copies.data());
+        }
+
+        writeSets();
     }
 
-    clearQueue.push_function([=] () {
-        vkFreeDescriptorSets(device->getDevice(), descriptorPool, descriptorSets.size(), descriptorSets.data());
+    // Device-local copies read the old buffers, the deletion queue also waits for that upload
+    device->getDeletionQueue()->push([=] () mutable {
+        for (auto& set : oldSets) {
+            d->getDescriptorAllocator()->free(set);
+        }
+
+        for (size_t i = 0; i < oldBuffers.size(); i++) {
+            d->destroyBuffer(oldBuffers[i], oldAllocations[i]);
+        }
     });
+}
 
-    for (size_t i = 0; i < 2; i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeOf * 1000;
+VkDescriptorSet VKFS::Descriptor::getSet(VKFS::Synchronization *sync) {
+    if (pushDescriptor) {
+        throw std::runtime_error("[VKFS] Push descriptors have no descriptor sets!");
+    }
 
-        std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+    return this->descriptorSets[sync->getCurrentFrame()].set;
+}
 
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
+size_t VKFS::Descriptor::getTemplateDataSize() {
+    return this->templateDataSize;
+}
 
-        vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+size_t VKFS::Descriptor::getTemplateOffset(uint32_t binding) {
+    for (auto& entry : templateEntries) {
+        if (entry.dstBinding == binding) {
+            return entry.offset;
+        }
     }
+
+    throw std::runtime_error("[VKFS] Descriptor has no binding " + std::to_string(binding) + "!");
 }
 
-VKFS::Descriptor::~Descriptor() {
-    vkDeviceWaitIdle(device->getDevice());
-    clearQueue.flush();
+void VKFS::Descriptor::updateWithTemplate(VKFS::Synchronization *sync, const void *data) {
+    if (!built || pushDescriptor) {
+        throw std::runtime_error("[VKFS] Only built descriptors with sets can be updated with a template!");
+    }
+
+    if (updateTemplate == VK_NULL_HANDLE) {
+        updateTemplate = createTemplate(VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET, VK_PIPELINE_BIND_POINT_GRAPHICS, VK_NULL_HANDLE, 0);
+    }
+
+    vkUpdateDescriptorSetWithTemplate(device->getDevice(), getSet(sync), updateTemplate, data);
 }
 
-void VKFS::Descriptor::createStorageImageSet(VkDescriptorImageInfo imageInfo) {
-    std::vector<VkDescriptorSetLayout> layouts(2, descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(2);
-    allocInfo.pSetLayouts = layouts.data();
+void VKFS::Descriptor::push(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set, const std::vector<VkWriteDescriptorSet> &writes) {
+    if (!pushDescriptor) {
+        throw std::runtime_error("[VKFS] Descriptor was not built with buildPushDescriptor()!");
+    }
 
-    descriptorSets.resize(2);
-    if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to allocate descriptor sets!");
+    cmdPushDescriptorSet(commandBuffer, bindPoint, layout, set, static_cast<uint32_t>(writes.size()), writes.data());
+}
+
+void VKFS::Descriptor::pushWithTemplate(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t set, const void *data) {
+    if (!pushDescriptor) {
+        throw std::runtime_error("[VKFS] Descriptor was not built with buildPushDescriptor()!");
     }
 
-    clearQueue.push_function([=] () {
-        vkFreeDescriptorSets(device->getDevice(), descriptorPool, descriptorSets.size(), descriptorSets.data());
-    });
+    // Only exposed when VK_KHR_push_descriptor meets Vulkan 1.1 or VK_KHR_descriptor_update_template
+    if (cmdPushDescriptorSetWithTemplate == nullptr) {
+        throw std::runtime_error("[VKFS] Pushing descriptors with a template needs Vulkan 1.1 on the device!");
+    }
 
-    for (size_t i = 0; i < 2; i++) {
-        // Set the image layout to the desired layout (e.g., VK_IMAGE_LAYOUT_GENERAL)
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    // Push templates are tied to a bind point, pipeline layout and set number, so one is kept per combination
+    auto key = std::make_tuple(bindPoint, layout, set);
+    auto found = pushTemplates.find(key);
+    if (found == pushTemplates.end()) {
+        found = pushTemplates.emplace(key, createTemplate(VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR, bindPoint, layout, set)).first;
+    }
 
-        std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+    cmdPushDescriptorSetWithTemplate(commandBuffer, found->second, layout, set, data);
+}
 
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pImageInfo = &imageInfo;
+bool VKFS::Descriptor::isPushDescriptor() {
+    return this->pushDescriptor;
+}
 
-        vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+uint32_t VKFS::Descriptor::getDynamicOffsetCount() {
+    uint32_t count = 0;
+    for (auto& binding : bindings) {
+        if (binding.stride != 0) {
+            count++;
+        }
     }
+
+    return count;
+}
+
+VKFS::Descriptor::~Descriptor() {
+    clearQueue.flush();
 }
@@ -0,0 +1,204 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/DescriptorAllocator.h"
+#include "../include/VKFS/Device.h"
+#include "../include/VKFS/Synchronization.h"
+
+// Descriptors a pool reserves per set for each type, multiplied by the pool's
+// set count. The pool is shared, so one set may use far more than its ratio.
+static const std::vector<std::pair<VkDescriptorType, float>> poolRatios = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f},
+        {VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+        {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f}
+};
+
+static const uint32_t maxPoolSets = 4096;
+
+VKFS::DescriptorAllocator::DescriptorAllocator(VKFS::Device *device, uint32_t setsPerPool) : device(device), setsPerPool(setsPerPool) {
+    persistent.nextPoolSets = setsPerPool;
+    persistent.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+    frames.resize(device->getFramesInFlight());
+    for (auto& frame : frames) {
+        frame.nextPoolSets = setsPerPool;
+    }
+}
+
+VKFS::DescriptorAllocator::~DescriptorAllocator() {
+    destroyChain(persistent);
+
+    for (auto& frame : frames) {
+        destroyChain(frame);
+    }
+}
+
+VkDescriptorPool VKFS::DescriptorAllocator::createPool(uint32_t maxSets, VkDescriptorPoolCreateFlags flags) {
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (auto& ratio : poolRatios) {
+        poolSizes.push_back({ratio.first, std::max(1u, static_cast<uint32_t>(ratio.second * maxSets))});
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = flags;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = maxSets;
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to create descriptor pool!");
+    }
+
+    return pool;
+}
+
+VKFS::DescriptorAllocation VKFS::DescriptorAllocator::allocateFromChain(VKFS::__DescriptorPoolChain &chain, VkDescriptorSetLayout layout) {
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    DescriptorAllocation allocation;
+    allocation.layout = layout;
+
+    // Every pool is tried at most once, then a fresh one gets the last chance
+    while (true) {
+        bool freshPool = chain.ready.empty();
+        if (freshPool) {
+            chain.ready.push_back(createPool(chain.nextPoolSets, chain.flags));
+            chain.nextPoolSets = std::min(maxPoolSets, chain.nextPoolSets + chain.nextPoolSets / 2);
+        }
+
+        allocInfo.descriptorPool = chain.ready.back();
+        VkResult result = vkAllocateDescriptorSets(device->getDevice(), &allocInfo, &allocation.set);
+
+        if (result == VK_SUCCESS) {
+            allocation.pool = allocInfo.descriptorPool;
+            return allocation;
+        }
+
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+            throw std::runtime_error("[VKFS] Failed to allocate descriptor sets!");
+        }
+
+        if (freshPool) {
+            throw std::runtime_error("[VKFS] Descriptor set layout does not fit in an empty descriptor pool!");
+        }
+
+        chain.full.push_back(chain.ready.back());
+        chain.ready.pop_back();
+    }
+}
+
+void VKFS::DescriptorAllocator::resetChain(VKFS::__DescriptorPoolChain &chain) {
+    for (auto pool : chain.full) {
+        chain.ready.push_back(pool);
+    }
+    chain.full.clear();
+
+    for (auto pool : chain.ready) {
+        vkResetDescriptorPool(device->getDevice(), pool, 0);
+    }
+}
+
+void VKFS::DescriptorAllocator::destroyChain(VKFS::__DescriptorPoolChain &chain) {
+    for (auto pool : chain.ready) {
+        vkDestroyDescriptorPool(device->getDevice(), pool, nullptr);
+    }
+
+    for (auto pool : chain.full) {
+        vkDestroyDescriptorPool(device->getDevice(), pool, nullptr);
+    }
+
+    chain.ready.clear();
+    chain.full.clear();
+}
+
+VKFS::DescriptorAllocation VKFS::DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+    auto recycled = freeSets.find(layout);
+    if (recycled != freeSets.end() && !recycled->second.empty()) {
+        DescriptorAllocation allocation = recycled->second.back();
+        recycled->second.pop_back();
+        return allocation;
+    }
+
+    return allocateFromChain(persistent, layout);
+}
+
+void VKFS::DescriptorAllocator::free(VKFS::DescriptorAllocation allocation) {
+    if (allocation.set == VK_NULL_HANDLE) {
+        return;
+    }
+
+    freeSets[allocation.layout].push_back(allocation);
+}
+
+void VKFS::DescriptorAllocator::releaseLayout(VkDescriptorSetLayout layout) {
+    auto recycled = freeSets.find(layout);
+    if (recycled == freeSets.end()) {
+        return;
+    }
+
+    // A new layout may reuse the handle, so its recycled sets go back to their pools
+    for (auto& allocation : recycled->second) {
+        vkFreeDescriptorSets(device->getDevice(), allocation.pool, 1, &allocation.set);
+
+        // The pool has room again; it goes behind the newest pool, which is tried first
+        auto full = std::find(persistent.full.begin(), persistent.full.end(), allocation.pool);
+        if (full != persistent.full.end()) {
+            persistent.full.erase(full);
+            persistent.ready.insert(persistent.ready.begin(), allocation.pool);
+        }
+    }
+
+    freeSets.erase(recycled);
+}
+
+VkDescriptorSet VKFS::DescriptorAllocator::allocateTransient(VKFS::Synchronization *sync, VkDescriptorSetLayout layout) {
+    __DescriptorPoolChain& frame = frames[sync->getCurrentFrame()];
+
+    // The caller waited for this slot's fence before recording, so its previous sets are no longer in use
+    if (frame.frameNumber != sync->getFrameNumber()) {
+        resetChain(frame);
+        frame.frameNumber = sync->getFrameNumber();
+    }
+
+    return allocateFromChain(frame, layout).set;
+}
+
+uint32_t VKFS::DescriptorAllocator::getPoolCount() {
+    size_t count = persistent.ready.size() + persistent.full.size();
+    for (auto& frame : frames) {
+        count += frame.ready.size() + frame.full.size();
+    }
+
+    return static_cast<uint32_t>(count);
+}
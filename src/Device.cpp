@@ -1,11 +1,20 @@
 
 
 #include <utility>
+#include <thread>
 #include "../include/VKFS/Device.h"
 
-VKFS::Device::Device(VKFS::Instance *instance, std::vector<const char*> deviceExtensions) {
+VKFS::Device::Device(VKFS::Instance *instance, std::vector<const char*> deviceExtensions, uint32_t framesInFlight, std::string pipelineCachePath, bool bindless) {
+    if (framesInFlight == 0) {
+        throw std::runtime_error("[VKFS] At least one frame in flight is required!");
+    }
+
     this->instance = instance;
+    this->framesInFlight = framesInFlight;
+    this->bindless = bindless;
     this->deviceExtensions = std::move(deviceExtensions);
+    this->headless = instance->getSurface() == VK_NULL_HANDLE;
+
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(instance->getNative(), &deviceCount, nullptr);
 
@@ -31,8 +40,65 @@ VKFS::Device::Device(VKFS::Instance *instance, std::vector<const char*> deviceEx
 
     std::cout << "[VKFS] Using " << props.deviceName << std::endl;
 
+    updateTemplates = instance->getAPIVersion() >= VK_API_VERSION_1_1 && props.apiVersion >= VK_API_VERSION_1_1;
+
+    // Optional, budget queries go through vkGetPhysicalDeviceMemoryProperties2 from Vulkan 1.1
+    if (instance->getAPIVersion() >= VK_API_VERSION_1_1 && props.apiVersion >= VK_API_VERSION_1_1 &&
+        hasDeviceExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        memoryBudget = true;
+        enableExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // Optional, lets TraceRecorder map GPU timestamps to the CPU clock
+    if (hasDeviceExtension(physicalDevice, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+        calibratedTimestamps = true;
+        enableExtension(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    }
+
     createLogicalDevice();
+
+    allocator = new Allocator(physicalDevice, device);
+    allocator->setBlockCallback([this] (uint32_t heap) {
+        checkBudget(heap);
+    });
+    clearQueue.push_function([=] () {
+        delete allocator;
+    });
+
     createCommandPool();
+
+    uploadContext = new UploadContext(this);
+    clearQueue.push_function([=] () {
+        delete uploadContext;
+    });
+
+    stagingRing = new StagingRing(this);
+    clearQueue.push_function([=] () {
+        delete stagingRing;
+    });
+
+    pipelineCache = new PipelineCache(this, pipelineCachePath);
+    clearQueue.push_function([=] () {
+        delete pipelineCache;
+    });
+
+    descriptorAllocator = new DescriptorAllocator(this);
+    clearQueue.push_function([=] () {
+        delete descriptorAllocator;
+    });
+
+    if (bindless) {
+        bindlessTable = new BindlessTable(this);
+        clearQueue.push_function([=] () {
+            delete bindlessTable;
+        });
+    }
+
+    // Destroyed first, its deletions still need the allocators above
+    deletionQueue = new DeletionQueue(this);
+    clearQueue.push_function([=] () {
+        delete deletionQueue;
+    });
 }
 
 bool VKFS::Device::isDeviceSuitable(VkPhysicalDevice device) {
@@ -40,8 +106,9 @@ bool VKFS::Device::isDeviceSuitable(VkPhysicalDevice device) {
 
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    // Without a surface there is nothing to present to, so the swapchain is not checked
+    bool swapChainAdequate = headless;
+    if (extensionsSupported && !headless) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
@@ -49,7 +116,38 @@ bool VKFS::Device::isDeviceSuitable(VkPhysicalDevice device) {
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-    return indices.isComplete() && extensionsSupported && swapChainAdequate  && supportedFeatures.samplerAnisotropy;
+    bool bindlessSupported = !bindless || checkBindlessSupport(device);
+
+    return indices.isComplete(!headless) && extensionsSupported && swapChainAdequate  && supportedFeatures.samplerAnisotropy && bindlessSupported;
+}
+
+bool VKFS::Device::supportsVulkan12(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(device, &props);
+
+    return instance->getAPIVersion() >= VK_API_VERSION_1_2 && props.apiVersion >= VK_API_VERSION_1_2;
+}
+
+bool VKFS::Device::checkBindlessSupport(VkPhysicalDevice device) {
+    if (!supportsVulkan12(device)) {
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return vulkan12Features.descriptorIndexing &&
+           vulkan12Features.shaderSampledImageArrayNonUniformIndexing &&
+           vulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+           vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind &&
+           vulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+           vulkan12Features.descriptorBindingPartiallyBound &&
+           vulkan12Features.runtimeDescriptorArray;
 }
 
 VKFS::QueueFamilyIndices VKFS::Device::findQueueFamilies(VkPhysicalDevice device) {
@@ -72,22 +170,65 @@ VKFS::QueueFamilyIndices VKFS::Device::findQueueFamilies(VkPhysicalDevice device
         }
 
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, instance->getSurface(), &presentSupport);
+        if (!headless) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, instance->getSurface(), &presentSupport);
+        }
 
         if (presentSupport) {
             indices.presentFamily = i;
         }
 
-        if (indices.isComplete()) {
+        if (indices.isComplete(!headless)) {
             break;
         }
 
         i++;
     }
 
+    // Prefer a transfer-only family (DMA engine), then any transfer family without graphics
+    i = 0;
+    for (const auto& queueFamily : queueFamilies) {
+        if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = i;
+            break;
+        }
+
+        if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.transferFamily.has_value()) {
+            indices.transferFamily = i;
+        }
+
+        i++;
+    }
+
     return indices;
 }
 
+void VKFS::Device::enableExtension(const char *extension) {
+    for (auto enabled : this->deviceExtensions) {
+        if (std::string(enabled) == extension) {
+            return;
+        }
+    }
+
+    this->deviceExtensions.push_back(extension);
+}
+
+bool VKFS::Device::hasDeviceExtension(VkPhysicalDevice device, const char *extension) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& available : availableExtensions) {
+        if (std::string(available.extensionName) == extension) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool VKFS::Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -136,7 +277,15 @@ void VKFS::Device::createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.computeFamily.value()};
+    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.computeFamily.value()};
+
+    if (indices.presentFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.presentFamily.value());
+    }
+
+    if (indices.transferFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -148,9 +297,19 @@ void VKFS::Device::createLogicalDevice() {
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+    // Optional, indirect draws fall back to one call per command without it
+    multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+
+    pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -159,6 +318,33 @@ void VKFS::Device::createLogicalDevice() {
 
     createInfo.pEnabledFeatures = &deviceFeatures;
 
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+
+    if (supportsVulkan12(physicalDevice)) {
+        VkPhysicalDeviceVulkan12Features supported12Features{};
+        supported12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &supported12Features;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+        drawIndirectCount = supported12Features.drawIndirectCount;
+        vulkan12Features.drawIndirectCount = supported12Features.drawIndirectCount;
+        createInfo.pNext = &vulkan12Features;
+    }
+
+    if (bindless) {
+        vulkan12Features.descriptorIndexing = VK_TRUE;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+        vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+    }
+
     createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -178,8 +364,17 @@ void VKFS::Device::createLogicalDevice() {
     });
 
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-    vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    if (indices.presentFamily.has_value()) {
+        vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    }
     vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+
+    dedicatedTransfer = indices.transferFamily.has_value();
+    if (dedicatedTransfer) {
+        vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+    } else {
+        transferQueue = graphicsQueue;
+    }
 }
 
 VkDevice VKFS::Device::getDevice() {
@@ -195,6 +390,10 @@ VkQueue VKFS::Device::getPresentQueue() {
 }
 
 VKFS::SwapChainSupportDetails VKFS::Device::getSwapchainSupport() {
+    if (headless) {
+        throw std::runtime_error("[VKFS] Headless device has no surface to query swapchain support for!");
+    }
+
     return this->querySwapChainSupport(this->physicalDevice);
 }
 
@@ -202,6 +401,10 @@ VKFS::Instance *VKFS::Device::getInstance() {
     return this->instance;
 }
 
+uint32_t VKFS::Device::getFramesInFlight() {
+    return this->framesInFlight;
+}
+
 VKFS::QueueFamilyIndices VKFS::Device::findQueueFamilies() {
     return this->findQueueFamilies(this->physicalDevice);
 }
@@ -244,30 +447,195 @@ uint32_t VKFS::Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags
 }
 
 void VKFS::Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                                VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
+                                VkBuffer &buffer, Allocation &bufferAllocation, MemoryCategory category, const std::string &owner) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+    // Staging memory is read by both upload queues
+    QueueFamilyIndices indices;
+    uint32_t families[2];
+    if (category == MEMORY_STAGING && hasDedicatedTransferQueue()) {
+        indices = findQueueFamilies();
+        families[0] = indices.graphicsFamily.value();
+        families[1] = indices.transferFamily.value();
+
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = families;
+    }
+
     if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to create buffer!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    bufferAllocation = allocator->allocateForBuffer(buffer, properties, category, owner);
+}
+
+void VKFS::Device::destroyBuffer(VkBuffer buffer, Allocation &bufferAllocation) {
+    if (uploadContext != nullptr) {
+        uploadContext->forgetBuffer(buffer);
+    }
+
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator->free(bufferAllocation);
+}
+
+VKFS::Allocator *VKFS::Device::getAllocator() {
+    return this->allocator;
+}
+
+VKFS::UploadContext *VKFS::Device::getUploadContext() {
+    return this->uploadContext;
+}
+
+VKFS::StagingRing *VKFS::Device::getStagingRing() {
+    return this->stagingRing;
+}
+
+VKFS::PipelineCache *VKFS::Device::getPipelineCache() {
+    return this->pipelineCache;
+}
+
+VKFS::DescriptorAllocator *VKFS::Device::getDescriptorAllocator() {
+    return this->descriptorAllocator;
+}
+
+bool VKFS::Device::isBindless() {
+    return this->bindless;
+}
+
+bool VKFS::Device::supportsPipelineStatistics() {
+    return this->pipelineStatisticsQuery;
+}
+
+bool VKFS::Device::supportsUpdateTemplates() {
+    return this->updateTemplates;
+}
+
+bool VKFS::Device::supportsMultiDrawIndirect() {
+    return this->multiDrawIndirect;
+}
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+bool VKFS::Device::supportsDrawIndirectCount() {
+    return this->drawIndirectCount;
+}
+
+bool VKFS::Device::hasMemoryBudget() {
+    return this->memoryBudget;
+}
+
+bool VKFS::Device::hasCalibratedTimestamps() {
+    return this->calibratedTimestamps;
+}
+
+std::vector<VKFS::HeapBudget> VKFS::Device::getMemoryBudget() {
+    const VkPhysicalDeviceMemoryProperties& memProperties = allocator->getMemoryProperties();
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to allocate buffer memory!");
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    if (memoryBudget) {
+        VkPhysicalDeviceMemoryProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &budgetProperties;
+
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+    }
+
+    std::vector<HeapBudget> heaps(memProperties.memoryHeapCount);
+
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+        heaps[i].size = memProperties.memoryHeaps[i].size;
+        heaps[i].allocated = allocator->getHeapAllocated(i);
+        heaps[i].budget = memoryBudget ? budgetProperties.heapBudget[i] : heaps[i].size;
+        heaps[i].usage = memoryBudget ? budgetProperties.heapUsage[i] : heaps[i].allocated;
+        heaps[i].deviceLocal = memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
     }
 
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    return heaps;
+}
+
+void VKFS::Device::setBudgetCallback(float threshold, std::function<void(uint32_t, const HeapBudget &)> callback) {
+    this->budgetThreshold = threshold;
+    this->budgetCallback = callback;
+}
+
+void VKFS::Device::checkBudget(uint32_t heap) {
+    if (!budgetCallback) {
+        return;
+    }
+
+    std::vector<HeapBudget> heaps = getMemoryBudget();
+
+    if (heap < heaps.size() && heaps[heap].usage > heaps[heap].budget * budgetThreshold) {
+        budgetCallback(heap, heaps[heap]);
+    }
+}
+
+void VKFS::Device::pollMemoryBudget() {
+    // Without VK_EXT_memory_budget usage only grows with VKFS blocks, which checkBudget() already sees
+    if (!budgetCallback || !memoryBudget) {
+        return;
+    }
+
+    std::vector<HeapBudget> heaps = getMemoryBudget();
+    heapsOverBudget.resize(heaps.size(), false);
+
+    for (uint32_t i = 0; i < heaps.size(); i++) {
+        bool over = heaps[i].usage > heaps[i].budget * budgetThreshold;
+
+        if (over && !heapsOverBudget[i]) {
+            budgetCallback(i, heaps[i]);
+        }
+
+        heapsOverBudget[i] = over;
+    }
+}
+
+VKFS::TraceRecorder *VKFS::Device::getTraceRecorder() {
+    return this->traceRecorder.load();
+}
+
+void VKFS::Device::setTraceRecorder(VKFS::TraceRecorder *recorder) {
+    this->traceRecorder.store(recorder);
+
+    // Spans that pinned the old recorder before the store finish before it goes away
+    if (recorder == nullptr) {
+        while (traceUsers.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+VKFS::TraceRecorder *VKFS::Device::acquireTraceRecorder() {
+    // Counted before the load, so setTraceRecorder(nullptr) either hides the recorder or waits for this span
+    traceUsers++;
+
+    TraceRecorder* recorder = traceRecorder.load();
+    if (recorder == nullptr) {
+        traceUsers--;
+    }
+
+    return recorder;
+}
+
+void VKFS::Device::releaseTraceRecorder() {
+    traceUsers--;
+}
+
+VKFS::BindlessTable *VKFS::Device::getBindlessTable() {
+    if (!bindless) {
+        throw std::runtime_error("[VKFS] Bindless mode is not enabled on this device!");
+    }
+
+    return this->bindlessTable;
+}
+
+VKFS::DeletionQueue *VKFS::Device::getDeletionQueue() {
+    return this->deletionQueue;
 }
 
 void VKFS::Device::createCommandPool() {
@@ -281,12 +649,34 @@ void VKFS::Device::createCommandPool() {
     if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to create graphics command pool!");
     }
+
+    clearQueue.push_function([=] () {
+        vkDestroyCommandPool(device, commandPool, nullptr);
+    });
+
+    if (dedicatedTransfer) {
+        poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to create transfer command pool!");
+        }
+
+        clearQueue.push_function([=] () {
+            vkDestroyCommandPool(device, transferCommandPool, nullptr);
+        });
+    } else {
+        transferCommandPool = commandPool;
+    }
 }
 
 VkCommandPool VKFS::Device::getCommandPool() {
     return this->commandPool;
 }
 
+VkCommandPool VKFS::Device::getTransferCommandPool() {
+    return this->transferCommandPool;
+}
+
 VkCommandBuffer VKFS::Device::beginSingleTimeCommands() {
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -314,20 +704,29 @@ void VKFS::Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    vkCreateFence(device, &fenceInfo, nullptr, &fence);
 
+    // Wait only for this submission instead of idling the whole queue
+    vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence);
+    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+    vkDestroyFence(device, fence, nullptr);
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
-void VKFS::Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
+VKFS::UploadTicket VKFS::Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset,
+                                            VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask) {
     VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = srcOffset;
+    copyRegion.dstOffset = dstOffset;
     copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    uploadContext->copyBuffer(srcBuffer, dstBuffer, copyRegion, dstAccessMask, dstStageMask);
 
-    endSingleTimeCommands(commandBuffer);
+    return uploadContext->getCurrentTicket();
 }
 
 VKFS::Device::~Device() {
@@ -338,3 +737,15 @@ VkQueue VKFS::Device::getComputeQueue() {
     return computeQueue;
 }
 
+
+VkQueue VKFS::Device::getTransferQueue() {
+    return transferQueue;
+}
+
+bool VKFS::Device::hasDedicatedTransferQueue() {
+    return dedicatedTransfer;
+}
+
+bool VKFS::Device::isHeadless() {
+    return headless;
+}
@@ -0,0 +1,212 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include "../include/VKFS/GPUProfiler.h"
+
+VKFS::GPUProfiler::GPUProfiler(VKFS::Device *device, VKFS::Synchronization *sync, uint32_t maxScopes) : device(device), sync(sync), maxScopes(maxScopes) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device->getPhysicalDevice(), &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device->getPhysicalDevice(), &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device->getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+    QueueFamilyIndices indices = device->findQueueFamilies();
+    std::optional<uint32_t> families[2] = {indices.graphicsFamily, indices.computeFamily};
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = maxScopes * 2;
+
+    for (int queue = 0; queue < 2; queue++) {
+        // Queues without valid timestamp bits leave scopes unmeasured
+        if (families[queue].has_value()) {
+            uint32_t validBits = queueFamilies[families[queue].value()].timestampValidBits;
+            timestampMask[queue] = validBits >= 64 ? UINT64_MAX : (validBits == 0 ? 0 : (uint64_t(1) << validBits) - 1);
+        }
+
+        frames[queue].resize(device->getFramesInFlight());
+        for (auto& frame : frames[queue]) {
+            if (vkCreateQueryPool(device->getDevice(), &poolInfo, nullptr, &frame.pool) != VK_SUCCESS) {
+                throw std::runtime_error("[VKFS] Failed to create timestamp query pool!");
+            }
+        }
+    }
+
+    sync->setProfiler(this);
+}
+
+VKFS::GPUProfiler::~GPUProfiler() {
+    sync->setProfiler(nullptr);
+
+    Device* d = device;
+    std::vector<VkQueryPool> pools;
+    for (auto& queueFrames : frames) {
+        for (auto& frame : queueFrames) {
+            pools.push_back(frame.pool);
+        }
+    }
+
+    // Frames in flight may still write their queries
+    device->getDeletionQueue()->push([=] () {
+        for (auto pool : pools) {
+            vkDestroyQueryPool(d->getDevice(), pool, nullptr);
+        }
+    });
+}
+
+void VKFS::GPUProfiler::beginScope(const std::string &name, VKFS::ProfilerQueue queue) {
+    if (!isSupported(queue)) {
+        return;
+    }
+
+    __ProfilerFrame& frame = frames[queue][sync->getCurrentFrame()];
+    if (frame.scopes.size() == maxScopes) {
+        throw std::runtime_error("[VKFS] GPU profiler is out of scopes for this frame!");
+    }
+
+    GPUScope scope;
+    scope.name = name;
+    scope.queue = queue;
+    scope.depth = static_cast<uint32_t>(frame.open.size());
+    scope.frameNumber = sync->getFrameNumber();
+
+    uint32_t index = static_cast<uint32_t>(frame.scopes.size());
+    frame.scopes.push_back(scope);
+    frame.open.push_back(index);
+
+    vkCmdWriteTimestamp(getCommandBuffer(queue), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, index * 2);
+}
+
+void VKFS::GPUProfiler::endScope(VKFS::ProfilerQueue queue) {
+    if (!isSupported(queue)) {
+        return;
+    }
+
+    __ProfilerFrame& frame = frames[queue][sync->getCurrentFrame()];
+    if (frame.open.empty()) {
+        throw std::runtime_error("[VKFS] GPU profiler scope ended without being begun!");
+    }
+
+    uint32_t index = frame.open.back();
+    frame.open.pop_back();
+
+    vkCmdWriteTimestamp(getCommandBuffer(queue), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.pool, index * 2 + 1);
+}
+
+void VKFS::GPUProfiler::beginRecording(VKFS::ProfilerQueue queue) {
+    if (!isSupported(queue)) {
+        return;
+    }
+
+    __ProfilerFrame& frame = frames[queue][sync->getCurrentFrame()];
+
+    if (!frame.open.empty()) {
+        throw std::runtime_error("[VKFS] GPU profiler scope \"" + frame.scopes[frame.open.back()].name + "\" was never ended!");
+    }
+
+    if (!frame.scopes.empty()) {
+        readResults(queue, frame);
+    }
+
+    frame.scopes.clear();
+    vkCmdResetQueryPool(getCommandBuffer(queue), frame.pool, 0, maxScopes * 2);
+}
+
+void VKFS::GPUProfiler::readResults(VKFS::ProfilerQueue queue, VKFS::__ProfilerFrame &frame) {
+    uint32_t queryCount = static_cast<uint32_t>(frame.scopes.size()) * 2;
+    std::vector<uint64_t> timestamps(queryCount);
+
+    // The frame's fence was waited before recording began, so the results are available
+    VkResult result = vkGetQueryPoolResults(device->getDevice(), frame.pool, 0, queryCount, timestamps.size() * sizeof(uint64_t),
+                                            timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    for (size_t i = 0; i < frame.scopes.size(); i++) {
+        GPUScope& scope = frame.scopes[i];
+        scope.beginTicks = timestamps[i * 2] & timestampMask[queue];
+        scope.endTicks = timestamps[i * 2 + 1] & timestampMask[queue];
+
+        // Masked counters may wrap between the two writes
+        uint64_t ticks = (scope.endTicks - scope.beginTicks) & timestampMask[queue];
+        scope.milliseconds = static_cast<double>(ticks) * timestampPeriod / 1000000.0;
+    }
+
+    results[queue] = frame.scopes;
+
+    for (auto& callback : resultCallbacks) {
+        callback.second(results[queue]);
+    }
+}
+
+const std::vector<VKFS::GPUScope> &VKFS::GPUProfiler::getResults(VKFS::ProfilerQueue queue) {
+    return results[queue];
+}
+
+double VKFS::GPUProfiler::getMilliseconds(const std::string &name, VKFS::ProfilerQueue queue) {
+    double milliseconds = 0.0;
+
+    for (auto& scope : results[queue]) {
+        if (scope.name == name) {
+            milliseconds += scope.milliseconds;
+        }
+    }
+
+    return milliseconds;
+}
+
+bool VKFS::GPUProfiler::isSupported(VKFS::ProfilerQueue queue) {
+    return timestampMask[queue] != 0;
+}
+
+double VKFS::GPUProfiler::getTimestampPeriod() {
+    return this->timestampPeriod;
+}
+
+uint32_t VKFS::GPUProfiler::addResultCallback(std::function<void(const std::vector<GPUScope> &)> callback) {
+    uint32_t id = nextCallback++;
+    resultCallbacks[id] = callback;
+    return id;
+}
+
+void VKFS::GPUProfiler::removeResultCallback(uint32_t id) {
+    resultCallbacks.erase(id);
+}
+
+VkCommandBuffer VKFS::GPUProfiler::getCommandBuffer(VKFS::ProfilerQueue queue) {
+    return queue == PROFILE_COMPUTE ? sync->getComputeCommandBuffer() : sync->getCommandBuffer();
+}
+
+VKFS::GPUProfileScope::GPUProfileScope(VKFS::GPUProfiler *profiler, const std::string &name, VKFS::ProfilerQueue queue) : profiler(profiler), queue(queue) {
+    profiler->beginScope(name, queue);
+}
+
+VKFS::GPUProfileScope::~GPUProfileScope() {
+    profiler->endScope(queue);
+}
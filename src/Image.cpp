@@ -10,24 +10,25 @@ VKFS::Image::Image(VKFS::Device *device, int width, int height, void *pixels, bo
     mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
     if (!_generateMipmaps) mipLevels = 1;
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    device->createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    StagingAllocation staging = device->getStagingRing()->upload(pixels, imageSize);
 
-    void* data;
-    vkMapMemory(device->getDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device->getDevice(), stagingBufferMemory);
-
-    createImage(width, height, mipLevels, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+    createImage(width, height, mipLevels, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation);
     transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
 
-    copyBufferToImage(stagingBuffer, image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    copyBufferToImage(staging.buffer, staging.offset, image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+
+    if (_generateMipmaps) {
+        // Blits need a graphics queue, so only ownership moves over here and mips are built there
+        VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+        device->getUploadContext()->transferImageOwnership(image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                           VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        generateMipmaps(image, VK_FORMAT_R8G8B8A8_SRGB, width, height, mipLevels);
+    } else {
+        changeLayout();
+    }
 
-    vkDestroyBuffer(device->getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(device->getDevice(), stagingBufferMemory, nullptr);
+    uploadTicket = device->getUploadContext()->getCurrentTicket();
 
-    if (_generateMipmaps) generateMipmaps(image, VK_FORMAT_R8G8B8A8_SRGB, width, height, mipLevels); else changeLayout();
     imageView = createImageView(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 
     VkPhysicalDeviceProperties properties{};
@@ -59,11 +60,14 @@ VKFS::Image::Image(VKFS::Device *device, int width, int height, void *pixels, bo
     imageInfo.imageView = imageView;
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
+    if (d->isBindless()) {
+        bindlessIndex = d->getBindlessTable()->registerTexture(imageInfo);
+    }
 }
 
 void VKFS::Image::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling,
                          VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image,
-                         VkDeviceMemory &imageMemory) {
+                         Allocation &imageAllocation) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -83,24 +87,13 @@ void VKFS::Image::createImage(uint32_t width, uint32_t height, uint32_t mipLevel
         throw std::runtime_error("[VKFS] Failed to create image!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(d->getDevice(), image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = d->findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(d->getDevice(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to allocate image memory!");
-    }
-
-    vkBindImageMemory(d->getDevice(), image, imageMemory, 0);
+    std::string owner = "Image " + std::to_string(width) + "x" + std::to_string(height);
+    imageAllocation = d->getAllocator()->allocateForImage(image, properties, tiling, MEMORY_IMAGE, owner);
 }
 
 void VKFS::Image::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
                                    uint32_t mipLevels) {
-    VkCommandBuffer commandBuffer = d->beginSingleTimeCommands();
+    VkCommandBuffer commandBuffer = d->getUploadContext()->getCommandBuffer();
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -142,15 +135,13 @@ void VKFS::Image::transitionImageLayout(VkImage image, VkFormat format, VkImageL
             0, nullptr,
             1, &barrier
     );
-
-    d->endSingleTimeCommands(commandBuffer);
 }
 
-void VKFS::Image::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-    VkCommandBuffer commandBuffer = d->beginSingleTimeCommands();
+void VKFS::Image::copyBufferToImage(VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height) {
+    VkCommandBuffer commandBuffer = d->getUploadContext()->getCommandBuffer();
 
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = bufferOffset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -165,8 +156,6 @@ void VKFS::Image::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t wid
     };
 
     vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    d->endSingleTimeCommands(commandBuffer);
 }
 
 void VKFS::Image::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight,
@@ -178,7 +167,7 @@ void VKFS::Image::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t t
         throw std::runtime_error("[VKFS] Image format does not support linear blitting!");
     }
 
-    VkCommandBuffer commandBuffer = d->beginSingleTimeCommands();
+    VkCommandBuffer commandBuffer = d->getUploadContext()->getGraphicsCommandBuffer();
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -252,8 +241,6 @@ void VKFS::Image::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t t
                          0, nullptr,
                          0, nullptr,
                          1, &barrier);
-
-    d->endSingleTimeCommands(commandBuffer);
 }
 
 VkImageView VKFS::Image::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
@@ -277,10 +264,24 @@ VkImageView VKFS::Image::createImageView(VkImage image, VkFormat format, VkImage
 }
 
 VKFS::Image::~Image() {
-    vkDeviceWaitIdle(d->getDevice());
-    vkDestroySampler(d->getDevice(), sampler, nullptr);
-    vkDestroyImageView(d->getDevice(), imageView, nullptr);
-    vkDestroyImage(d->getDevice(), image, nullptr);
+    Device* device = d;
+    uint32_t index = bindlessIndex;
+    VkSampler sampler = this->sampler;
+    VkImageView imageView = this->imageView;
+    VkImage image = this->image;
+    Allocation allocation = imageAllocation;
+
+    // Frames in flight may still sample the image, the deletion queue also covers its pending upload
+    d->getDeletionQueue()->push([=] () mutable {
+        if (index != UINT32_MAX) {
+            device->getBindlessTable()->releaseTexture(index);
+        }
+
+        vkDestroySampler(device->getDevice(), sampler, nullptr);
+        vkDestroyImageView(device->getDevice(), imageView, nullptr);
+        vkDestroyImage(device->getDevice(), image, nullptr);
+        device->getAllocator()->free(allocation);
+    });
 }
 
 VkImage VKFS::Image::getImage() {
@@ -303,35 +304,22 @@ uint32_t VKFS::Image::getMipLevels() {
     return mipLevels;
 }
 
+VKFS::UploadTicket VKFS::Image::getUploadTicket() {
+    return uploadTicket;
+}
+
 void VKFS::Image::changeLayout() {
-    VkImageMemoryBarrier imageMemoryBarrier = {};
-    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.image = image;
-    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-    imageMemoryBarrier.subresourceRange.levelCount = 1;
-    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-    imageMemoryBarrier.subresourceRange.layerCount = 1;
-
-    imageMemoryBarrier.srcAccessMask = 0;
-    imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    VkCommandBuffer tmp = d->beginSingleTimeCommands();
-    vkCmdPipelineBarrier(
-            tmp,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &imageMemoryBarrier
-    );
+    VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
 
-    d->endSingleTimeCommands(tmp);
+    // Releases the image from the transfer queue and acquires it on the graphics queue in shader read layout
+    d->getUploadContext()->transferImageOwnership(image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                  VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
 
+uint32_t VKFS::Image::getBindlessIndex() {
+    if (bindlessIndex == UINT32_MAX) {
+        throw std::runtime_error("[VKFS] Image is not registered in a bindless table!");
+    }
 
+    return this->bindlessIndex;
 }
@@ -0,0 +1,66 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include "../include/VKFS/IndexConversion.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VKFS_INDEX_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VKFS_INDEX_NEON
+#endif
+
+void VKFS::narrowIndices(const uint32_t *src, uint16_t *dst, size_t count) {
+    size_t i = 0;
+
+#if defined(VKFS_INDEX_SSE2)
+    // SSE2 only packs with signed saturation, so the low halves are sign-extended first to pass through unchanged
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+    }
+#elif defined(VKFS_INDEX_NEON)
+    for (; i + 8 <= count; i += 8) {
+        uint16x4_t low = vmovn_u32(vld1q_u32(src + i));
+        uint16x4_t high = vmovn_u32(vld1q_u32(src + i + 4));
+
+        vst1q_u16(dst + i, vcombine_u16(low, high));
+    }
+#endif
+
+    for (; i < count; i++) {
+        dst[i] = static_cast<uint16_t>(src[i]);
+    }
+}
+
+bool VKFS::fitsIn16BitIndices(uint32_t vertexCount) {
+    // Primitive restart is disabled in every VKFS pipeline, so 0xFFFF is an ordinary index
+    return vertexCount <= 65536;
+}
@@ -0,0 +1,156 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/IndirectBuffer.h"
+
+VKFS::IndirectBuffer::IndirectBuffer(VKFS::Device *device, uint32_t maxDraws, bool useCountBuffer) : device(device), maxDraws(maxDraws) {
+    if (maxDraws == 0) {
+        throw std::runtime_error("[VKFS] Indirect buffer needs room for at least one draw!");
+    }
+
+    if (useCountBuffer && !device->supportsDrawIndirectCount()) {
+        throw std::runtime_error("[VKFS] Indirect count buffers need the Vulkan 1.2 drawIndirectCount feature!");
+    }
+
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    device->createBuffer(sizeof(VkDrawIndexedIndirectCommand) * maxDraws, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferAllocation, MEMORY_BUFFER, "IndirectBuffer");
+
+    if (useCountBuffer) {
+        device->createBuffer(sizeof(uint32_t), usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, countBuffer, countBufferAllocation, MEMORY_BUFFER, "IndirectBuffer count");
+    }
+}
+
+VKFS::IndirectBuffer::~IndirectBuffer() {
+    Device* device = this->device;
+    VkBuffer buffer = this->buffer;
+    VkBuffer countBuffer = this->countBuffer;
+    Allocation bufferAllocation = this->bufferAllocation;
+    Allocation countBufferAllocation = this->countBufferAllocation;
+
+    device->getDeletionQueue()->push([=] () mutable {
+        device->destroyBuffer(buffer, bufferAllocation);
+
+        if (countBuffer != VK_NULL_HANDLE) {
+            device->destroyBuffer(countBuffer, countBufferAllocation);
+        }
+    });
+}
+
+VKFS::UploadTicket VKFS::IndirectBuffer::upload(const std::vector<VkDrawIndexedIndirectCommand> &commands) {
+    if (commands.size() > maxDraws) {
+        throw std::runtime_error("[VKFS] Too many commands for the indirect buffer!");
+    }
+
+    drawCount = static_cast<uint32_t>(commands.size());
+
+    // Read by indirect draws, and cleared and rewritten by culling shaders
+    VkAccessFlags consumerAccess = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    VkPipelineStageFlags consumerStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    if (!commands.empty()) {
+        VkDeviceSize size = sizeof(VkDrawIndexedIndirectCommand) * commands.size();
+        StagingAllocation staging = device->getStagingRing()->upload(commands.data(), size);
+        uploadTicket = device->copyBuffer(staging.buffer, buffer, size, staging.offset, 0, consumerAccess, consumerStages);
+    }
+
+    if (countBuffer != VK_NULL_HANDLE) {
+        StagingAllocation staging = device->getStagingRing()->upload(&drawCount, sizeof(uint32_t));
+        uploadTicket = device->copyBuffer(staging.buffer, countBuffer, sizeof(uint32_t), staging.offset, 0, consumerAccess, consumerStages);
+    }
+
+    return uploadTicket;
+}
+
+void VKFS::IndirectBuffer::setDrawCount(uint32_t drawCount) {
+    if (drawCount > maxDraws) {
+        throw std::runtime_error("[VKFS] Draw count is larger than the indirect buffer!");
+    }
+
+    this->drawCount = drawCount;
+}
+
+void VKFS::IndirectBuffer::resetCount(VKFS::Synchronization *sync) {
+    if (countBuffer == VK_NULL_HANDLE) {
+        throw std::runtime_error("[VKFS] Indirect buffer has no count buffer!");
+    }
+
+    vkCmdFillBuffer(sync->getComputeCommandBuffer(), countBuffer, 0, sizeof(uint32_t), 0);
+
+    // Compute shaders append to the count with atomics after the clear
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = countBuffer;
+    barrier.offset = 0;
+    barrier.size = sizeof(uint32_t);
+
+    vkCmdPipelineBarrier(sync->getComputeCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void VKFS::IndirectBuffer::draw(VKFS::Synchronization *sync) {
+    VkCommandBuffer commandBuffer = sync->getCommandBuffer();
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    if (countBuffer != VK_NULL_HANDLE) {
+        vkCmdDrawIndexedIndirectCount(commandBuffer, buffer, 0, countBuffer, 0, maxDraws, stride);
+    } else if (device->supportsMultiDrawIndirect()) {
+        vkCmdDrawIndexedIndirect(commandBuffer, buffer, 0, drawCount, stride);
+    } else {
+        // Without multiDrawIndirect every indirect call may only read one command
+        for (uint32_t i = 0; i < drawCount; i++) {
+            vkCmdDrawIndexedIndirect(commandBuffer, buffer, static_cast<VkDeviceSize>(i) * stride, 1, stride);
+        }
+    }
+}
+
+VkBuffer VKFS::IndirectBuffer::getBuffer() {
+    return this->buffer;
+}
+
+VkBuffer VKFS::IndirectBuffer::getCountBuffer() {
+    return this->countBuffer;
+}
+
+VkDescriptorBufferInfo VKFS::IndirectBuffer::getCommandsInfo() {
+    return {buffer, 0, sizeof(VkDrawIndexedIndirectCommand) * maxDraws};
+}
+
+VkDescriptorBufferInfo VKFS::IndirectBuffer::getCountInfo() {
+    if (countBuffer == VK_NULL_HANDLE) {
+        throw std::runtime_error("[VKFS] Indirect buffer has no count buffer!");
+    }
+
+    return {countBuffer, 0, sizeof(uint32_t)};
+}
+
+uint32_t VKFS::IndirectBuffer::getMaxDraws() {
+    return this->maxDraws;
+}
+
+uint32_t VKFS::IndirectBuffer::getDrawCount() {
+    return this->drawCount;
+}
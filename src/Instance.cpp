@@ -34,6 +34,7 @@ VKFS::Instance::Instance(std::string appName, std::string engineName, std::vecto
     }
 
     this->useDebug = enableValidationLayers;
+    this->apiVersion = APIVersion;
 
     VkApplicationInfo appInfo{};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -138,6 +139,10 @@ VkSurfaceKHR VKFS::Instance::getSurface() {
     return this->surface;
 }
 
+uint32_t VKFS::Instance::getAPIVersion() {
+    return this->apiVersion;
+}
+
 VKFS::Instance::~Instance() {
     clearQueue.flush();
 }
@@ -0,0 +1,113 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include "../include/VKFS/MeshPool.h"
+
+VKFS::FreeList::FreeList(uint32_t capacity) : capacity(capacity) {
+    if (capacity > 0) {
+        ranges[0] = capacity;
+    }
+}
+
+bool VKFS::FreeList::allocate(uint32_t count, uint32_t &offset) {
+    if (count == 0) {
+        offset = 0;
+        return true;
+    }
+
+    for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+        if (it->second < count) {
+            continue;
+        }
+
+        offset = it->first;
+        uint32_t remaining = it->second - count;
+        ranges.erase(it);
+
+        if (remaining > 0) {
+            ranges[offset + count] = remaining;
+        }
+
+        used += count;
+        return true;
+    }
+
+    return false;
+}
+
+void VKFS::FreeList::free(uint32_t offset, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    if (offset + count > capacity || count > used) {
+        throw std::runtime_error("[VKFS] Freeing a range that was not allocated!");
+    }
+
+    auto next = ranges.lower_bound(offset);
+    if (next != ranges.end() && offset + count > next->first) {
+        throw std::runtime_error("[VKFS] Freeing a range that was not allocated!");
+    }
+
+    if (next != ranges.begin() && std::prev(next)->first + std::prev(next)->second > offset) {
+        throw std::runtime_error("[VKFS] Freeing a range that was not allocated!");
+    }
+
+    used -= count;
+
+    // Merge with the free ranges on both sides
+    if (next != ranges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            count += prev->second;
+            ranges.erase(prev);
+        }
+    }
+
+    if (next != ranges.end() && offset + count == next->first) {
+        count += next->second;
+        ranges.erase(next);
+    }
+
+    ranges[offset] = count;
+}
+
+uint32_t VKFS::FreeList::getCapacity() {
+    return this->capacity;
+}
+
+uint32_t VKFS::FreeList::getUsed() {
+    return this->used;
+}
+
+uint32_t VKFS::FreeList::getLargestFreeRange() {
+    uint32_t largest = 0;
+
+    for (auto& range : ranges) {
+        largest = std::max(largest, range.second);
+    }
+
+    return largest;
+}
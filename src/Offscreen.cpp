@@ -3,6 +3,7 @@
 //
 
 #include "../include/VKFS/Offscreen.h"
+#include "../include/VKFS/PipelineStatistics.h"
 
 VKFS::Offscreen::Offscreen(VKFS::Device *device, VKFS::Synchronization* sync, int colorAttachmentsCount, bool enableDepthAttachment, int width, int height, OffscreenImageFilter imageFilter) : d(device), w(width), h(height), filter(imageFilter), sync(sync) {
     this->colorAttachmentsCount = colorAttachmentsCount;
@@ -154,21 +155,12 @@ VKFS::__OffscreenImage VKFS::Offscreen::createColorImage() {
     image.tiling = VK_IMAGE_TILING_OPTIMAL;
     image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    VkMemoryRequirements memReqs;
-
     vkCreateImage(d->getDevice(), &image, nullptr, &ret.image);
-    vkGetImageMemoryRequirements(d->getDevice(), ret.image, &memReqs);
-    memAlloc.allocationSize = memReqs.size;
-    memAlloc.memoryTypeIndex = d->findMemoryType(memReqs.memoryTypeBits,
-                                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    vkAllocateMemory(d->getDevice(), &memAlloc, nullptr, &ret.imageMemory);
-    vkBindImageMemory(d->getDevice(), ret.image, ret.imageMemory, 0);
+    ret.imageAllocation = d->getAllocator()->allocateForImage(ret.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_TILING_OPTIMAL, MEMORY_ATTACHMENT, name + " color");
 
-    clearQueue.push_function([=] () {
+    clearQueue.push_function([=] () mutable {
         vkDestroyImage(d->getDevice(), ret.image, nullptr);
-        vkFreeMemory(d->getDevice(), ret.imageMemory, nullptr);
+        d->getAllocator()->free(ret.imageAllocation);
     });
 
     VkImageViewCreateInfo colorImageViewInfo = {};
@@ -213,20 +205,11 @@ void VKFS::Offscreen::createDepthImage() {
 
     vkCreateImage(d->getDevice(), &image, nullptr, &depthImage);
 
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    VkMemoryRequirements memReqs;
-
-    vkGetImageMemoryRequirements(d->getDevice(), depthImage, &memReqs);
-
-    memAlloc.allocationSize = memReqs.size;
-    memAlloc.memoryTypeIndex = d->findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    vkAllocateMemory(d->getDevice(), &memAlloc, nullptr, &depthImageMemory);
-    vkBindImageMemory(d->getDevice(), depthImage, depthImageMemory, 0);
+    depthImageAllocation = d->getAllocator()->allocateForImage(depthImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_TILING_OPTIMAL, MEMORY_ATTACHMENT, name + " depth");
 
     clearQueue.push_function([=] () {
         vkDestroyImage(d->getDevice(), depthImage, nullptr);
-        vkFreeMemory(d->getDevice(), depthImageMemory, nullptr);
+        d->getAllocator()->free(depthImageAllocation);
     });
 
     VkImageViewCreateInfo depthStencilView = {};
@@ -323,12 +306,29 @@ void VKFS::Offscreen::beginRenderpass(float clearR, float clearG, float clearB,
 
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
+
+    if (sync->getPipelineStatistics() != nullptr) {
+        sync->getPipelineStatistics()->beginPass(name);
+    }
+
     vkCmdBeginRenderPass(sync->getCommandBuffer(), &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 }
 
 void VKFS::Offscreen::endRenderpass() {
     vkCmdEndRenderPass(sync->getCommandBuffer());
+
+    if (sync->getPipelineStatistics() != nullptr) {
+        sync->getPipelineStatistics()->endPass();
+    }
+}
+
+void VKFS::Offscreen::setName(const std::string &name) {
+    this->name = name;
+}
+
+std::string VKFS::Offscreen::getName() {
+    return this->name;
 }
 
 VKFS::Offscreen::~Offscreen() {
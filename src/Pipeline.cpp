@@ -21,6 +21,7 @@ OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "../include/VKFS/Pipeline.h"
+#include "../include/VKFS/TraceRecorder.h"
 
 VKFS::Pipeline::Pipeline(VKFS::Device *device, VkVertexInputBindingDescription bindingDescription, std::vector<VkVertexInputAttributeDescription> attribDescription, VkRenderPass renderPass, std::vector<Descriptor*> descriptors, int colorAttachmentsCount) : d(device), colorAttachmentsCount(colorAttachmentsCount), renderPass(renderPass) {
     attributes = attribDescription;
@@ -37,10 +38,11 @@ void VKFS::Pipeline::addShader(VKFS::ShaderType type, VKFS::ShaderModule *shader
     shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStageInfo.stage = getVulkanStage(type);
     shaderStageInfo.module = shader->getShaderModule();
-    shaderStageInfo.pName = funcname.c_str();
-
 
+    // pName is set in build(), entryPoints can still reallocate while shaders are added
     stages.push_back(shaderStageInfo);
+    entryPoints.push_back(funcname);
+    shaderModules.push_back(shader);
 }
 
 VkShaderStageFlagBits VKFS::Pipeline::getVulkanStage(VKFS::ShaderType type) {
@@ -64,7 +66,13 @@ VkPipelineLayout VKFS::Pipeline::getPipelineLayout() {
     return this->layout;
 }
 
+const std::vector<VkDescriptorSetLayout> &VKFS::Pipeline::getDescriptorSetLayouts() {
+    return this->setLayouts;
+}
+
 void VKFS::Pipeline::build() {
+    TraceSpan span(d, "Pipeline::build");
+
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputInfo.vertexBindingDescriptionCount = 1;
@@ -148,22 +156,73 @@ void VKFS::Pipeline::build() {
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    std::vector<VkDescriptorSetLayout> lays;
+    std::vector<const ShaderReflection*> reflections;
+    for (ShaderModule* shader : shaderModules) {
+        reflections.push_back(&shader->getReflection());
+    }
+
+    if (descriptors.empty()) {
+        // No descriptors given, derive minimal set layouts from the shaders. Sets with runtime arrays use the bindless table
+        auto mergedBindings = ShaderReflection::mergeBindings(reflections);
+
+        std::map<uint32_t, VkDescriptorSetLayout> bindlessLayouts;
+        if (d->isBindless()) {
+            bindlessLayouts = d->getBindlessTable()->matchSets(mergedBindings);
+        }
+
+        setLayouts = ShaderReflection::createSetLayouts(d->getDevice(), mergedBindings, bindlessLayouts);
+
+        std::vector<VkDescriptorSetLayout> reflectedLayouts = setLayouts;
+        clearQueue.push_function([=] () {
+            for (uint32_t set = 0; set < reflectedLayouts.size(); set++) {
+                if (bindlessLayouts.find(set) == bindlessLayouts.end()) {
+                    vkDestroyDescriptorSetLayout(d->getDevice(), reflectedLayouts[set], nullptr);
+                }
+            }
+        });
+    } else {
+        std::vector<std::vector<VkDescriptorSetLayoutBinding>> providedBindings;
+
+        setLayouts.clear();
+        for (Descriptor* descriptor : descriptors) {
+            setLayouts.push_back(descriptor->getDescriptorSetLayout());
+            providedBindings.push_back(descriptor->getBindings());
+        }
+
+        ShaderReflection::validateSetLayouts(reflections, providedBindings);
+    }
+
+    for (const ShaderReflection* reflection : reflections) {
+        for (const ReflectedVertexInput& input : reflection->getVertexInputs()) {
+            bool found = false;
+            for (auto& attribute : attributes) {
+                found |= attribute.location == input.location;
+            }
 
-    for (Descriptor* descriptor : descriptors) {
-        lays.push_back(descriptor->getDescriptorSetLayout());
+            if (!found) {
+                throw std::runtime_error("[VKFS] Vertex shader input at location " + std::to_string(input.location) + " has no vertex attribute!");
+            }
+        }
     }
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = lays.size();
-    pipelineLayoutInfo.pSetLayouts = lays.data();
+    pipelineLayoutInfo.setLayoutCount = setLayouts.size();
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+
+    VkPushConstantRange pushConsts = ShaderReflection::mergePushConstants(reflections);
 
     if (pushConstantsEnabled) {
-        VkPushConstantRange pushConsts;
+        if (pushConsts.size > pushConstantsSize) {
+            throw std::runtime_error("[VKFS] Push constant block in the shaders is larger than the size passed to enablePushConstants()!");
+        }
+
         pushConsts.offset = 0;
         pushConsts.size = pushConstantsSize;
         pushConsts.stageFlags = getVulkanStage(pushConstantsShader);
+    }
+
+    if (pushConsts.size > 0) {
         pipelineLayoutInfo.pPushConstantRanges = &pushConsts;
         pipelineLayoutInfo.pushConstantRangeCount = 1;
     }
@@ -176,6 +235,10 @@ void VKFS::Pipeline::build() {
         vkDestroyPipelineLayout(d->getDevice(), layout, nullptr);
     });
 
+    for (size_t i = 0; i < stages.size(); i++) {
+        stages[i].pName = entryPoints[i].c_str();
+    }
+
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.stageCount = stages.size();
@@ -205,13 +268,19 @@ void VKFS::Pipeline::build() {
         }
     }
 
-    if (vkCreateGraphicsPipelines(d->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+    if (vkCreateGraphicsPipelines(d->getDevice(), d->getPipelineCache()->getPipelineCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to create graphics pipeline!");
     }
 
     clearQueue.push_function([=] () {
         vkDestroyPipeline(d->getDevice(), pipeline, nullptr);
     });
+
+    ready = true;
+}
+
+bool VKFS::Pipeline::isReady() {
+    return ready;
 }
 
 void VKFS::Pipeline::enablePushConstants(size_t sizeOf, ShaderType shader) {
@@ -0,0 +1,160 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/PipelineCache.h"
+#include "../include/VKFS/Device.h"
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+
+VKFS::PipelineCache::PipelineCache(VKFS::Device *device, std::string path) : device(device), path(std::move(path)) {
+    std::vector<char> data;
+
+    if (!this->path.empty()) {
+        data = readFile(this->path);
+
+        if (!data.empty() && !isCompatible(data)) {
+            std::cout << "[VKFS] Pipeline cache " << this->path << " was created by another device or driver, ignoring it" << std::endl;
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    VkResult result = vkCreatePipelineCache(device->getDevice(), &cacheInfo, nullptr, &pipelineCache);
+
+    // Drivers may still reject data that passes the header check, start empty in that case
+    if (result != VK_SUCCESS && !data.empty()) {
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        data.clear();
+
+        result = vkCreatePipelineCache(device->getDevice(), &cacheInfo, nullptr, &pipelineCache);
+    }
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to create pipeline cache!");
+    }
+
+    loadedFromDisk = !data.empty();
+}
+
+VKFS::PipelineCache::~PipelineCache() {
+    if (!path.empty()) {
+        save();
+    }
+
+    vkDestroyPipelineCache(device->getDevice(), pipelineCache, nullptr);
+}
+
+std::vector<char> VKFS::PipelineCache::readFile(const std::string &path) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open()) {
+        return {};
+    }
+
+    size_t fileSize = (size_t) file.tellg();
+    std::vector<char> buffer(fileSize);
+
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+
+    return buffer;
+}
+
+bool VKFS::PipelineCache::isCompatible(const std::vector<char> &data) {
+    // VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+    const size_t headerSize = 16 + VK_UUID_SIZE;
+
+    if (data.size() < headerSize) {
+        return false;
+    }
+
+    uint32_t header[4];
+    memcpy(header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(device->getPhysicalDevice(), &props);
+
+    return header[0] >= headerSize &&
+           header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header[2] == props.vendorID &&
+           header[3] == props.deviceID &&
+           memcmp(data.data() + 16, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool VKFS::PipelineCache::save() {
+    if (path.empty()) {
+        return false;
+    }
+
+    return save(path);
+}
+
+bool VKFS::PipelineCache::save(const std::string &path) {
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device->getDevice(), pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+        return false;
+    }
+
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device->getDevice(), pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+        return false;
+    }
+
+    // Write next to the target and rename, so a crash never leaves a truncated cache behind (POSIX replaces atomically)
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file.write(data.data(), dataSize);
+        if (!file.good()) {
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    std::remove(path.c_str());
+#endif
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+VkPipelineCache VKFS::PipelineCache::getPipelineCache() {
+    return pipelineCache;
+}
+
+bool VKFS::PipelineCache::isLoadedFromDisk() {
+    return loadedFromDisk;
+}
+
+std::string VKFS::PipelineCache::getPath() {
+    return path;
+}
@@ -0,0 +1,147 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/PipelineCompiler.h"
+
+VKFS::PipelineCompiler::PipelineCompiler(uint32_t threadCount) {
+    if (threadCount == 0) {
+        // Leave one core for the render thread
+        uint32_t cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back([this] () {
+            workerLoop();
+        });
+    }
+}
+
+VKFS::PipelineCompiler::~PipelineCompiler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    taskAvailable.notify_all();
+
+    // Workers drain the queue before exiting, so every returned future gets a result
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void VKFS::PipelineCompiler::workerLoop() {
+    while (true) {
+        std::packaged_task<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] () {
+                return stopping || !tasks.empty();
+            });
+
+            if (tasks.empty()) {
+                return;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        // Exceptions are stored in the future by packaged_task
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+
+        idle.notify_all();
+    }
+}
+
+std::shared_future<void> VKFS::PipelineCompiler::enqueue(std::function<void()> &&function) {
+    std::packaged_task<void()> task(std::move(function));
+    std::shared_future<void> future = task.get_future().share();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+        pending++;
+    }
+
+    taskAvailable.notify_one();
+
+    return future;
+}
+
+std::shared_future<void> VKFS::PipelineCompiler::compile(VKFS::Pipeline *pipeline) {
+    return enqueue([pipeline] () {
+        pipeline->build();
+    });
+}
+
+std::shared_future<void> VKFS::PipelineCompiler::compile(VKFS::ComputePipeline *pipeline) {
+    return enqueue([pipeline] () {
+        pipeline->build();
+    });
+}
+
+std::vector<std::shared_future<void>> VKFS::PipelineCompiler::compile(const std::vector<Pipeline*> &pipelines) {
+    std::vector<std::shared_future<void>> futures;
+    futures.reserve(pipelines.size());
+
+    for (Pipeline* pipeline : pipelines) {
+        futures.push_back(compile(pipeline));
+    }
+
+    return futures;
+}
+
+std::vector<std::shared_future<void>> VKFS::PipelineCompiler::compile(const std::vector<ComputePipeline*> &pipelines) {
+    std::vector<std::shared_future<void>> futures;
+    futures.reserve(pipelines.size());
+
+    for (ComputePipeline* pipeline : pipelines) {
+        futures.push_back(compile(pipeline));
+    }
+
+    return futures;
+}
+
+void VKFS::PipelineCompiler::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] () {
+        return pending == 0;
+    });
+}
+
+uint32_t VKFS::PipelineCompiler::getPendingCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending;
+}
+
+uint32_t VKFS::PipelineCompiler::getThreadCount() {
+    return static_cast<uint32_t>(workers.size());
+}
@@ -0,0 +1,206 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include "../include/VKFS/PipelineStatistics.h"
+
+// Counters in the order Vulkan writes them, which follows the flag bits
+static const VkQueryPipelineStatisticFlags graphicsStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+                                                                VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+                                                                VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                                VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+                                                                VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                                VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+static const uint32_t graphicsCounters = 6;
+
+// Compute-only queues may not count graphics statistics
+static const VkQueryPipelineStatisticFlags computeStatistics = VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+static const uint32_t computeCounters = 1;
+
+VKFS::PipelineStatistics::PipelineStatistics(VKFS::Device *device, VKFS::Synchronization *sync, uint32_t maxPasses) : device(device), sync(sync), maxPasses(maxPasses) {
+    if (!device->supportsPipelineStatistics()) {
+        throw std::runtime_error("[VKFS] Device does not support pipeline statistics queries!");
+    }
+
+    for (int queue = 0; queue < 2; queue++) {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = maxPasses;
+        poolInfo.pipelineStatistics = queue == PROFILE_GRAPHICS ? graphicsStatistics : computeStatistics;
+
+        frames[queue].resize(device->getFramesInFlight());
+        for (auto& frame : frames[queue]) {
+            if (vkCreateQueryPool(device->getDevice(), &poolInfo, nullptr, &frame.pool) != VK_SUCCESS) {
+                throw std::runtime_error("[VKFS] Failed to create pipeline statistics query pool!");
+            }
+        }
+    }
+
+    sync->setPipelineStatistics(this);
+}
+
+VKFS::PipelineStatistics::~PipelineStatistics() {
+    sync->setPipelineStatistics(nullptr);
+
+    Device* d = device;
+    std::vector<VkQueryPool> pools;
+    for (auto& queueFrames : frames) {
+        for (auto& frame : queueFrames) {
+            pools.push_back(frame.pool);
+        }
+    }
+
+    // Frames in flight may still write their queries
+    device->getDeletionQueue()->push([=] () {
+        for (auto pool : pools) {
+            vkDestroyQueryPool(d->getDevice(), pool, nullptr);
+        }
+    });
+}
+
+void VKFS::PipelineStatistics::beginPass(const std::string &name, VKFS::ProfilerQueue queue) {
+    __StatisticsFrame& frame = frames[queue][sync->getCurrentFrame()];
+
+    if (frame.active || frame.passes.size() == maxPasses) {
+        skipped[queue]++;
+        return;
+    }
+
+    uint32_t index = static_cast<uint32_t>(frame.passes.size());
+    frame.passes.push_back(name);
+    frame.frameNumber = sync->getFrameNumber();
+    frame.active = true;
+
+    vkCmdBeginQuery(getCommandBuffer(queue), frame.pool, index, 0);
+}
+
+void VKFS::PipelineStatistics::endPass(VKFS::ProfilerQueue queue) {
+    __StatisticsFrame& frame = frames[queue][sync->getCurrentFrame()];
+
+    // Matches a beginPass() that was not counted
+    if (skipped[queue] > 0) {
+        skipped[queue]--;
+        return;
+    }
+
+    if (!frame.active) {
+        throw std::runtime_error("[VKFS] Pipeline statistics pass ended without being begun!");
+    }
+
+    frame.active = false;
+    vkCmdEndQuery(getCommandBuffer(queue), frame.pool, static_cast<uint32_t>(frame.passes.size()) - 1);
+}
+
+void VKFS::PipelineStatistics::beginRecording(VKFS::ProfilerQueue queue) {
+    __StatisticsFrame& frame = frames[queue][sync->getCurrentFrame()];
+
+    if (frame.active) {
+        throw std::runtime_error("[VKFS] Pipeline statistics pass \"" + frame.passes.back() + "\" was never ended!");
+    }
+
+    if (!frame.passes.empty()) {
+        readResults(queue, frame);
+    }
+
+    frame.passes.clear();
+    skipped[queue] = 0;
+    vkCmdResetQueryPool(getCommandBuffer(queue), frame.pool, 0, maxPasses);
+}
+
+void VKFS::PipelineStatistics::readResults(VKFS::ProfilerQueue queue, VKFS::__StatisticsFrame &frame) {
+    uint32_t counters = queue == PROFILE_GRAPHICS ? graphicsCounters : computeCounters;
+    uint32_t queryCount = static_cast<uint32_t>(frame.passes.size());
+    std::vector<uint64_t> values(queryCount * counters);
+
+    // The frame's fence was waited before recording began, a pass that is still not available is skipped
+    VkResult result = vkGetQueryPoolResults(device->getDevice(), frame.pool, 0, queryCount, values.size() * sizeof(uint64_t),
+                                            values.data(), counters * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    std::map<std::string, PassStatistics> passes;
+
+    for (uint32_t i = 0; i < queryCount; i++) {
+        PassStatistics& pass = passes[frame.passes[i]];
+        pass.name = frame.passes[i];
+        pass.frameNumber = frame.frameNumber;
+
+        const uint64_t* value = &values[i * counters];
+        if (queue == PROFILE_GRAPHICS) {
+            pass.inputAssemblyVertices += value[0];
+            pass.inputAssemblyPrimitives += value[1];
+            pass.vertexShaderInvocations += value[2];
+            pass.clippingInvocations += value[3];
+            pass.clippingPrimitives += value[4];
+            pass.fragmentShaderInvocations += value[5];
+        } else {
+            pass.computeShaderInvocations += value[0];
+        }
+    }
+
+    // A graphics and a compute pass may share a name, so each queue only replaces its own counters
+    for (auto& pass : passes) {
+        PassStatistics& merged = results[pass.first];
+        merged.name = pass.first;
+        merged.frameNumber = pass.second.frameNumber;
+
+        if (queue == PROFILE_GRAPHICS) {
+            merged.inputAssemblyVertices = pass.second.inputAssemblyVertices;
+            merged.inputAssemblyPrimitives = pass.second.inputAssemblyPrimitives;
+            merged.vertexShaderInvocations = pass.second.vertexShaderInvocations;
+            merged.clippingInvocations = pass.second.clippingInvocations;
+            merged.clippingPrimitives = pass.second.clippingPrimitives;
+            merged.fragmentShaderInvocations = pass.second.fragmentShaderInvocations;
+        } else {
+            merged.computeShaderInvocations = pass.second.computeShaderInvocations;
+        }
+    }
+}
+
+VKFS::PassStatistics VKFS::PipelineStatistics::getPass(const std::string &name) {
+    auto found = results.find(name);
+    if (found == results.end()) {
+        PassStatistics empty;
+        empty.name = name;
+        return empty;
+    }
+
+    return found->second;
+}
+
+std::vector<VKFS::PassStatistics> VKFS::PipelineStatistics::getPasses() {
+    std::vector<PassStatistics> passes;
+    passes.reserve(results.size());
+
+    for (auto& pass : results) {
+        passes.push_back(pass.second);
+    }
+
+    return passes;
+}
+
+VkCommandBuffer VKFS::PipelineStatistics::getCommandBuffer(VKFS::ProfilerQueue queue) {
+    return queue == PROFILE_COMPUTE ? sync->getComputeCommandBuffer() : sync->getCommandBuffer();
+}
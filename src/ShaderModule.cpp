@@ -5,6 +5,7 @@
 VKFS::ShaderModule::ShaderModule(VKFS::Device *device, std::string path) : device(device) {
     auto code = readFile(path);
     shader = createShaderModule(code);
+    reflection = ShaderReflection(reinterpret_cast<const uint32_t*>(code.data()), code.size() / sizeof(uint32_t));
 }
 
 std::vector<char> VKFS::ShaderModule::readFile(const std::string &filename) {
@@ -42,3 +43,7 @@ VkShaderModule VKFS::ShaderModule::createShaderModule(const std::vector<char> &c
 VkShaderModule VKFS::ShaderModule::getShaderModule() {
     return this->shader;
 }
+
+const VKFS::ShaderReflection &VKFS::ShaderModule::getReflection() {
+    return this->reflection;
+}
@@ -0,0 +1,533 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/ShaderReflection.h"
+#include <unordered_map>
+#include <algorithm>
+
+namespace {
+
+    // Subset of the SPIR-V specification used by the parser
+    enum SpvOp {
+        OpEntryPoint = 15, OpExecutionMode = 16,
+        OpTypeBool = 20, OpTypeInt = 21, OpTypeFloat = 22, OpTypeVector = 23, OpTypeMatrix = 24,
+        OpTypeImage = 25, OpTypeSampler = 26, OpTypeSampledImage = 27, OpTypeArray = 28,
+        OpTypeRuntimeArray = 29, OpTypeStruct = 30, OpTypePointer = 32, OpConstant = 43,
+        OpVariable = 59, OpDecorate = 71, OpMemberDecorate = 72, OpTypeAccelerationStructureKHR = 5341
+    };
+
+    enum SpvDecoration {
+        DecorationBufferBlock = 3, DecorationArrayStride = 6, DecorationMatrixStride = 7,
+        DecorationBuiltIn = 11, DecorationLocation = 30, DecorationBinding = 33, DecorationDescriptorSet = 34,
+        DecorationOffset = 35
+    };
+
+    enum SpvStorageClass {
+        StorageClassUniformConstant = 0, StorageClassInput = 1, StorageClassUniform = 2,
+        StorageClassPushConstant = 9, StorageClassStorageBuffer = 12
+    };
+
+    enum SpvDim {
+        DimBuffer = 5, DimSubpassData = 6
+    };
+
+    const uint32_t ExecutionModeLocalSize = 17;
+
+    struct SpvVariable {
+        uint32_t pointerType;
+        uint32_t id;
+        uint32_t storage;
+    };
+
+    struct SpvType {
+        uint32_t op = 0;
+        std::vector<uint32_t> operands;
+    };
+
+    struct SpvDecorations {
+        bool bufferBlock = false;
+        bool builtIn = false;
+        uint32_t set = 0;
+        uint32_t binding = 0;
+        uint32_t location = 0;
+        bool hasBinding = false;
+        bool hasLocation = false;
+        uint32_t arrayStride = 0;
+        std::unordered_map<uint32_t, uint32_t> memberOffsets;
+        std::unordered_map<uint32_t, uint32_t> memberMatrixStrides;
+    };
+
+    struct SpvModule {
+        std::unordered_map<uint32_t, SpvType> types;
+        std::unordered_map<uint32_t, uint32_t> constants;
+        std::unordered_map<uint32_t, SpvDecorations> decorations;
+
+        uint32_t arrayLength(const SpvType& type) const {
+            auto it = constants.find(type.operands[1]);
+            return it != constants.end() ? it->second : 1;
+        }
+
+        uint32_t sizeOf(uint32_t typeId, uint32_t matrixStride = 0) const {
+            auto it = types.find(typeId);
+            if (it == types.end()) return 0;
+            const SpvType& type = it->second;
+
+            switch (type.op) {
+                case OpTypeBool:
+                    return 4;
+                case OpTypeInt:
+                case OpTypeFloat:
+                    return type.operands[0] / 8;
+                case OpTypeVector:
+                    return sizeOf(type.operands[0]) * type.operands[1];
+                case OpTypeMatrix:
+                    return (matrixStride != 0 ? matrixStride : sizeOf(type.operands[0])) * type.operands[1];
+                case OpTypeArray: {
+                    auto decoration = decorations.find(typeId);
+                    uint32_t stride = decoration != decorations.end() && decoration->second.arrayStride != 0
+                            ? decoration->second.arrayStride : sizeOf(type.operands[0], matrixStride);
+                    return stride * arrayLength(type);
+                }
+                case OpTypeRuntimeArray:
+                    return 0;
+                case OpTypeStruct: {
+                    auto decoration = decorations.find(typeId);
+                    uint32_t size = 0;
+
+                    for (uint32_t member = 0; member < type.operands.size(); member++) {
+                        uint32_t offset = 0;
+                        uint32_t stride = 0;
+
+                        if (decoration != decorations.end()) {
+                            auto offsetIt = decoration->second.memberOffsets.find(member);
+                            if (offsetIt != decoration->second.memberOffsets.end()) offset = offsetIt->second;
+
+                            auto strideIt = decoration->second.memberMatrixStrides.find(member);
+                            if (strideIt != decoration->second.memberMatrixStrides.end()) stride = strideIt->second;
+                        }
+
+                        size = std::max(size, offset + sizeOf(type.operands[member], stride));
+                    }
+
+                    return size;
+                }
+                default:
+                    return 0;
+            }
+        }
+
+        VkFormat formatOf(uint32_t typeId) const {
+            auto it = types.find(typeId);
+            if (it == types.end()) return VK_FORMAT_UNDEFINED;
+
+            uint32_t components = 1;
+            SpvType scalar = it->second;
+
+            if (scalar.op == OpTypeVector) {
+                components = scalar.operands[1];
+                scalar = types.at(scalar.operands[0]);
+            }
+
+            static const VkFormat floats[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+            static const VkFormat doubles[] = {VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT};
+            static const VkFormat sints[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+            static const VkFormat uints[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+
+            if (components < 1 || components > 4) return VK_FORMAT_UNDEFINED;
+
+            if (scalar.op == OpTypeFloat) {
+                return scalar.operands[0] == 64 ? doubles[components - 1] : floats[components - 1];
+            } else if (scalar.op == OpTypeInt && scalar.operands[0] == 32) {
+                return scalar.operands[1] ? sints[components - 1] : uints[components - 1];
+            }
+
+            return VK_FORMAT_UNDEFINED;
+        }
+    };
+
+    VkShaderStageFlagBits toStage(uint32_t executionModel) {
+        switch (executionModel) {
+            case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+            case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+            case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+            case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+            case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+            case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+            default: return VK_SHADER_STAGE_ALL;
+        }
+    }
+
+}
+
+VKFS::ShaderReflection::ShaderReflection(const uint32_t *code, size_t wordCount) {
+    if (wordCount < 5 || code[0] != 0x07230203) {
+        throw std::runtime_error("[VKFS] Shader code is not valid SPIR-V!");
+    }
+
+    SpvModule module;
+    std::vector<SpvVariable> variables;
+    uint32_t entryPointId = 0;
+    bool entryPointFound = false;
+
+    size_t offset = 5;
+    while (offset < wordCount) {
+        uint32_t opcode = code[offset] & 0xFFFF;
+        uint32_t length = code[offset] >> 16;
+
+        if (length == 0 || offset + length > wordCount) {
+            throw std::runtime_error("[VKFS] Shader code is truncated SPIR-V!");
+        }
+
+        const uint32_t* args = code + offset + 1;
+        uint32_t argCount = length - 1;
+
+        switch (opcode) {
+            case OpEntryPoint:
+                // Only the first entry point is used, VKFS pipelines take one per module
+                if (!entryPointFound && argCount >= 3) {
+                    stage = toStage(args[0]);
+                    entryPointId = args[1];
+                    entryPoint = std::string(reinterpret_cast<const char*>(args + 2));
+                    entryPointFound = true;
+                }
+                break;
+
+            case OpExecutionMode:
+                if (argCount >= 5 && args[0] == entryPointId && args[1] == ExecutionModeLocalSize) {
+                    localSize[0] = args[2];
+                    localSize[1] = args[3];
+                    localSize[2] = args[4];
+                }
+                break;
+
+            case OpDecorate: {
+                if (argCount < 2) break;
+                SpvDecorations& decoration = module.decorations[args[0]];
+
+                switch (args[1]) {
+                    case DecorationBufferBlock: decoration.bufferBlock = true; break;
+                    case DecorationBuiltIn: decoration.builtIn = true; break;
+                    case DecorationArrayStride: if (argCount >= 3) decoration.arrayStride = args[2]; break;
+                    case DecorationLocation: if (argCount >= 3) { decoration.location = args[2]; decoration.hasLocation = true; } break;
+                    case DecorationBinding: if (argCount >= 3) { decoration.binding = args[2]; decoration.hasBinding = true; } break;
+                    case DecorationDescriptorSet: if (argCount >= 3) decoration.set = args[2]; break;
+                    default: break;
+                }
+                break;
+            }
+
+            case OpMemberDecorate: {
+                if (argCount < 4) break;
+                SpvDecorations& decoration = module.decorations[args[0]];
+
+                switch (args[2]) {
+                    case DecorationOffset: decoration.memberOffsets[args[1]] = args[3]; break;
+                    case DecorationMatrixStride: decoration.memberMatrixStrides[args[1]] = args[3]; break;
+                    case DecorationBuiltIn: decoration.builtIn = true; break;
+                    default: break;
+                }
+                break;
+            }
+
+            case OpTypeBool:
+            case OpTypeInt:
+            case OpTypeFloat:
+            case OpTypeVector:
+            case OpTypeMatrix:
+            case OpTypeImage:
+            case OpTypeSampler:
+            case OpTypeSampledImage:
+            case OpTypeArray:
+            case OpTypeRuntimeArray:
+            case OpTypeStruct:
+            case OpTypePointer:
+            case OpTypeAccelerationStructureKHR: {
+                if (argCount < 1) break;
+                SpvType type;
+                type.op = opcode;
+                type.operands.assign(args + 1, args + argCount);
+                module.types[args[0]] = type;
+                break;
+            }
+
+            case OpConstant:
+                if (argCount >= 3) module.constants[args[1]] = args[2];
+                break;
+
+            case OpVariable:
+                if (argCount >= 3) variables.push_back({args[0], args[1], args[2]});
+                break;
+
+            default:
+                break;
+        }
+
+        offset += length;
+    }
+
+    for (const SpvVariable& variable : variables) {
+        uint32_t id = variable.id;
+        uint32_t storage = variable.storage;
+
+        auto pointer = module.types.find(variable.pointerType);
+        if (pointer == module.types.end() || pointer->second.op != OpTypePointer) continue;
+
+        uint32_t typeId = pointer->second.operands[1];
+        const SpvDecorations& decoration = module.decorations[id];
+
+        if (storage == StorageClassPushConstant) {
+            pushConstantSize = std::max(pushConstantSize, module.sizeOf(typeId));
+            continue;
+        }
+
+        if (storage == StorageClassInput) {
+            if (stage == VK_SHADER_STAGE_VERTEX_BIT && decoration.hasLocation && !decoration.builtIn &&
+                !module.decorations[typeId].builtIn) {
+                vertexInputs.push_back({decoration.location, module.formatOf(typeId)});
+            }
+            continue;
+        }
+
+        if (storage != StorageClassUniformConstant && storage != StorageClassUniform && storage != StorageClassStorageBuffer) continue;
+        if (!decoration.hasBinding) continue;
+
+        // Unwrap arrays of resources
+        uint32_t count = 1;
+        SpvType type = module.types[typeId];
+        uint32_t elementId = typeId;
+
+        if (type.op == OpTypeArray) {
+            count = module.arrayLength(type);
+            elementId = type.operands[0];
+        } else if (type.op == OpTypeRuntimeArray) {
+            count = 0;
+            elementId = type.operands[0];
+        }
+
+        const SpvType& element = module.types[elementId];
+        VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+
+        switch (element.op) {
+            case OpTypeSampler:
+                descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+                break;
+            case OpTypeSampledImage:
+                descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                break;
+            case OpTypeImage: {
+                // Operands: sampled type, dim, depth, arrayed, ms, sampled, format
+                uint32_t dim = element.operands[1];
+                bool storageImage = element.operands[5] == 2;
+
+                if (dim == DimBuffer) {
+                    descriptorType = storageImage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                } else if (dim == DimSubpassData) {
+                    descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                } else {
+                    descriptorType = storageImage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                }
+                break;
+            }
+            case OpTypeStruct:
+                if (storage == StorageClassStorageBuffer || module.decorations[elementId].bufferBlock) {
+                    descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                } else {
+                    descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                }
+                break;
+            default:
+                break;
+        }
+
+        if (descriptorType == VK_DESCRIPTOR_TYPE_MAX_ENUM) continue;
+
+        bindings.push_back({decoration.set, decoration.binding, descriptorType, count});
+    }
+}
+
+VkShaderStageFlagBits VKFS::ShaderReflection::getStage() const {
+    return stage;
+}
+
+const std::string &VKFS::ShaderReflection::getEntryPoint() const {
+    return entryPoint;
+}
+
+const std::vector<VKFS::ReflectedBinding> &VKFS::ShaderReflection::getBindings() const {
+    return bindings;
+}
+
+uint32_t VKFS::ShaderReflection::getPushConstantSize() const {
+    return pushConstantSize;
+}
+
+const std::vector<VKFS::ReflectedVertexInput> &VKFS::ShaderReflection::getVertexInputs() const {
+    return vertexInputs;
+}
+
+const uint32_t *VKFS::ShaderReflection::getLocalSize() const {
+    return localSize;
+}
+
+std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> VKFS::ShaderReflection::mergeBindings(const std::vector<const ShaderReflection*> &reflections) {
+    std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+
+    for (const ShaderReflection* reflection : reflections) {
+        for (const ReflectedBinding& binding : reflection->getBindings()) {
+            auto& set = sets[binding.set];
+            auto it = set.find(binding.binding);
+
+            if (it == set.end()) {
+                VkDescriptorSetLayoutBinding layoutBinding{};
+                layoutBinding.binding = binding.binding;
+                layoutBinding.descriptorType = binding.type;
+                layoutBinding.descriptorCount = binding.count;
+                layoutBinding.stageFlags = reflection->getStage();
+                set[binding.binding] = layoutBinding;
+                continue;
+            }
+
+            if (it->second.descriptorType != binding.type) {
+                throw std::runtime_error("[VKFS] Shader stages disagree on the descriptor type of set " + std::to_string(binding.set) +
+                                         " binding " + std::to_string(binding.binding) + "!");
+            }
+
+            it->second.stageFlags |= reflection->getStage();
+            if (binding.count == 0 || it->second.descriptorCount == 0) {
+                it->second.descriptorCount = 0;
+            } else {
+                it->second.descriptorCount = std::max(it->second.descriptorCount, binding.count);
+            }
+        }
+    }
+
+    std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> result;
+    for (auto& set : sets) {
+        for (auto& binding : set.second) {
+            result[set.first].push_back(binding.second);
+        }
+    }
+
+    return result;
+}
+
+VkPushConstantRange VKFS::ShaderReflection::mergePushConstants(const std::vector<const ShaderReflection*> &reflections) {
+    VkPushConstantRange range{};
+
+    for (const ShaderReflection* reflection : reflections) {
+        if (reflection->getPushConstantSize() == 0) continue;
+
+        range.size = std::max(range.size, reflection->getPushConstantSize());
+        range.stageFlags |= reflection->getStage();
+    }
+
+    return range;
+}
+
+std::vector<VkDescriptorSetLayout> VKFS::ShaderReflection::createSetLayouts(VkDevice device, const std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> &sets,
+                                                                            const std::map<uint32_t, VkDescriptorSetLayout> &providedLayouts) {
+    std::vector<VkDescriptorSetLayout> layouts;
+    if (sets.empty()) return layouts;
+
+    uint32_t setCount = sets.rbegin()->first + 1;
+
+    for (uint32_t set = 0; set < setCount; set++) {
+        // Provided layouts are owned by the caller and are not created here
+        auto provided = providedLayouts.find(set);
+        if (provided != providedLayouts.end()) {
+            layouts.push_back(provided->second);
+            continue;
+        }
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+        auto it = sets.find(set);
+        if (it != sets.end()) bindings = it->second;
+
+        for (auto& binding : bindings) {
+            if (binding.descriptorCount == 0) {
+                throw std::runtime_error("[VKFS] Runtime-sized descriptor array at set " + std::to_string(set) + " binding " +
+                                         std::to_string(binding.binding) + " needs an explicit descriptor set layout!");
+            }
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            for (uint32_t createdSet = 0; createdSet < layouts.size(); createdSet++) {
+                if (providedLayouts.find(createdSet) == providedLayouts.end()) {
+                    vkDestroyDescriptorSetLayout(device, layouts[createdSet], nullptr);
+                }
+            }
+
+            throw std::runtime_error("[VKFS] Failed to create reflected descriptor set layout!");
+        }
+
+        layouts.push_back(layout);
+    }
+
+    return layouts;
+}
+
+void VKFS::ShaderReflection::validateSetLayouts(const std::vector<const ShaderReflection*> &reflections, const std::vector<std::vector<VkDescriptorSetLayoutBinding>> &sets) {
+    for (auto& set : mergeBindings(reflections)) {
+        std::string where = "set " + std::to_string(set.first);
+
+        if (set.first >= sets.size()) {
+            throw std::runtime_error("[VKFS] Shaders use " + where + " but the pipeline only has " + std::to_string(sets.size()) + " descriptor set layouts!");
+        }
+
+        for (const VkDescriptorSetLayoutBinding& expected : set.second) {
+            std::string binding = where + " binding " + std::to_string(expected.binding);
+
+            auto provided = std::find_if(sets[set.first].begin(), sets[set.first].end(), [&] (const VkDescriptorSetLayoutBinding& b) {
+                return b.binding == expected.binding;
+            });
+
+            if (provided == sets[set.first].end()) {
+                throw std::runtime_error("[VKFS] Shaders use " + binding + " which is missing from the descriptor set layout!");
+            }
+
+            // SPIR-V does not say whether a buffer is bound with a dynamic offset, so both variants match
+            VkDescriptorType providedType = provided->descriptorType;
+            if (providedType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) providedType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            if (providedType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) providedType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+            if (providedType != expected.descriptorType) {
+                throw std::runtime_error("[VKFS] Descriptor type of " + binding + " does not match the shaders!");
+            }
+
+            if ((provided->stageFlags & expected.stageFlags) != expected.stageFlags) {
+                throw std::runtime_error("[VKFS] Stage flags of " + binding + " do not include every shader stage that uses it!");
+            }
+
+            if (expected.descriptorCount != 0 && provided->descriptorCount < expected.descriptorCount) {
+                throw std::runtime_error("[VKFS] Descriptor count of " + binding + " is smaller than the shader array!");
+            }
+        }
+    }
+}
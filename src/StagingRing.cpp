@@ -0,0 +1,146 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/StagingRing.h"
+#include "../include/VKFS/Device.h"
+
+VKFS::StagingRing::StagingRing(VKFS::Device *device, VkDeviceSize capacity) : device(device), capacity(capacity) {
+    device->createBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, bufferAllocation, MEMORY_STAGING, "StagingRing");
+
+    if (bufferAllocation.mapped == nullptr) {
+        throw std::runtime_error("[VKFS] Failed to map staging ring!");
+    }
+}
+
+VKFS::StagingRing::~StagingRing() {
+    device->getUploadContext()->waitIdle();
+    device->destroyBuffer(buffer, bufferAllocation);
+}
+
+void VKFS::StagingRing::reclaim() {
+    while (!regions.empty() && device->getUploadContext()->isComplete(regions.front().ticket)) {
+        tail = regions.front().end;
+        regions.pop_front();
+    }
+
+    if (regions.empty()) {
+        tail = head;
+    }
+}
+
+VKFS::StagingAllocation VKFS::StagingRing::allocateDedicated(VkDeviceSize size) {
+    StagingAllocation allocation;
+    Allocation dedicatedAllocation;
+
+    device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, allocation.buffer, dedicatedAllocation, MEMORY_STAGING, "StagingRing dedicated");
+    allocation.size = size;
+    allocation.mapped = dedicatedAllocation.mapped;
+
+    VkBuffer dedicatedBuffer = allocation.buffer;
+    VKFS::Device* d = device;
+    device->getUploadContext()->onComplete([=] () mutable {
+        d->destroyBuffer(dedicatedBuffer, dedicatedAllocation);
+    });
+
+    return allocation;
+}
+
+VKFS::StagingAllocation VKFS::StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    if (alignment == 0) {
+        throw std::runtime_error("[VKFS] Staging ring alignment must not be zero!");
+    }
+
+    UploadContext* uploadContext = device->getUploadContext();
+
+    // Open a batch so the region is tied to the batch that will read it
+    uploadContext->getCommandBuffer();
+
+    if (size > capacity / 2) {
+        return allocateDedicated(size);
+    }
+
+    reclaim();
+
+    // Nothing in flight, so restart at the beginning instead of wrapping around
+    if (regions.empty()) {
+        head = 0;
+        tail = 0;
+    }
+
+    uint64_t position = head % capacity;
+    uint64_t aligned = (position + alignment - 1) / alignment * alignment;
+
+    // Never split an allocation across the end of the ring, skip the remainder instead
+    if (aligned + size > capacity) {
+        head += capacity - position;
+        aligned = 0;
+    } else {
+        head += aligned - position;
+    }
+
+    while (!regions.empty() && head + size - tail > capacity) {
+        // Ring is full, wait for the oldest batch that still owns space
+        uploadContext->wait(regions.front().ticket);
+        reclaim();
+
+        // wait() may have submitted the current batch, so open a new one for this allocation
+        uploadContext->getCommandBuffer();
+    }
+
+    head += size;
+
+    UploadTicket ticket = uploadContext->getCurrentTicket();
+    if (!regions.empty() && regions.back().ticket == ticket) {
+        regions.back().end = head;
+    } else {
+        regions.push_back({ticket, head});
+    }
+
+    StagingAllocation allocation;
+    allocation.buffer = buffer;
+    allocation.offset = aligned;
+    allocation.size = size;
+    allocation.mapped = static_cast<char*>(bufferAllocation.mapped) + aligned;
+
+    return allocation;
+}
+
+VKFS::StagingAllocation VKFS::StagingRing::upload(const void *data, VkDeviceSize size, VkDeviceSize alignment) {
+    StagingAllocation allocation = allocate(size, alignment);
+    memcpy(allocation.mapped, data, static_cast<size_t>(size));
+
+    return allocation;
+}
+
+VkBuffer VKFS::StagingRing::getBuffer() {
+    return buffer;
+}
+
+VkDeviceSize VKFS::StagingRing::getCapacity() {
+    return capacity;
+}
+
+VkDeviceSize VKFS::StagingRing::getUsedBytes() {
+    reclaim();
+    return head - tail;
+}
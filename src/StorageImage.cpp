@@ -27,19 +27,7 @@ VKFS::StorageImage::StorageImage(VKFS::Device *device, int width, int height) :
     }
 
     // Выделяем память для VkImage
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device->getDevice(), image_, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = device->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    if (vkAllocateMemory(device->getDevice(), &allocInfo, nullptr, &imageMemory_) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to allocate memory for VkImage!");
-    }
-
-    vkBindImageMemory(device->getDevice(), image_, imageMemory_, 0);
+    imageAllocation_ = device->getAllocator()->allocateForImage(image_, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_TILING_OPTIMAL, MEMORY_IMAGE, "StorageImage");
 
     // Создаем VkImageView
     VkImageViewCreateInfo viewInfo = {};
@@ -96,7 +84,7 @@ VKFS::StorageImage::StorageImage(VKFS::Device *device, int width, int height) :
     imageMemoryBarrier.srcAccessMask = 0;
     imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
 
-    VkCommandBuffer tmp = device->beginSingleTimeCommands();
+    VkCommandBuffer tmp = device->getUploadContext()->getGraphicsCommandBuffer();
     vkCmdPipelineBarrier(
             tmp,
             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
@@ -107,9 +95,6 @@ VKFS::StorageImage::StorageImage(VKFS::Device *device, int width, int height) :
             1, &imageMemoryBarrier
     );
 
-
-    device->endSingleTimeCommands(tmp);
-
     descriptorImageInfo.sampler = sampler_;
     descriptorImageInfo.imageView = imageView_;
     descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -141,19 +126,7 @@ void VKFS::StorageImage::createImageForShader() {
         throw std::runtime_error("[VKFS] Failed to create image!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(d->getDevice(), shaderImage, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = d->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    if (vkAllocateMemory(d->getDevice(), &allocInfo, nullptr, &shaderImageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to allocate image memory!");
-    }
-
-    vkBindImageMemory(d->getDevice(), shaderImage, shaderImageMemory, 0);
+    shaderImageAllocation = d->getAllocator()->allocateForImage(shaderImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_TILING_OPTIMAL, MEMORY_IMAGE, "StorageImage");
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -186,7 +159,7 @@ void VKFS::StorageImage::createImageForShader() {
     imageMemoryBarrier.srcAccessMask = 0;
     imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
 
-    VkCommandBuffer tmp = d->beginSingleTimeCommands();
+    VkCommandBuffer tmp = d->getUploadContext()->getGraphicsCommandBuffer();
     vkCmdPipelineBarrier(
             tmp,
             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
@@ -197,8 +170,6 @@ void VKFS::StorageImage::createImageForShader() {
             1, &imageMemoryBarrier
     );
 
-    d->endSingleTimeCommands(tmp);
-
     shaderDescriptorImageInfo.sampler = sampler_;
     shaderDescriptorImageInfo.imageView = shaderImageView;
     shaderDescriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
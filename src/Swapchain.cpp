@@ -1,6 +1,7 @@
 
 
 #include "../include/VKFS/Swapchain.h"
+#include "../include/VKFS/TraceRecorder.h"
 
 VKFS::Swapchain::Swapchain(VKFS::Device *device, int windowWidth, int windowHeight) : device(device), windowWidth(windowWidth), windowHeight(windowHeight) {
     create();
@@ -96,7 +97,7 @@ void VKFS::Swapchain::createFramebuffers() {
 void
 VKFS::Swapchain::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling,
                              VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image,
-                             VkDeviceMemory &imageMemory) {
+                             Allocation &imageAllocation) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -116,19 +117,7 @@ VKFS::Swapchain::createImage(uint32_t width, uint32_t height, uint32_t mipLevels
         throw std::runtime_error("[VKFS] Failed to create image!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device->getDevice(), image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = device->findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device->getDevice(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("[VKFS] Failed to allocate image memory!");
-    }
-
-    vkBindImageMemory(device->getDevice(), image, imageMemory, 0);
+    imageAllocation = device->getAllocator()->allocateForImage(image, properties, tiling, MEMORY_ATTACHMENT, "Swapchain depth");
 }
 
 VkSwapchainKHR VKFS::Swapchain::getSwapchain() {
@@ -136,27 +125,37 @@ VkSwapchainKHR VKFS::Swapchain::getSwapchain() {
 }
 
 void VKFS::Swapchain::recreate(int windowWidth, int windowHeight) {
-    vkDeviceWaitIdle(device->getDevice());
-
-    vkDestroyImageView(device->getDevice(), depthImageView, nullptr);
-    vkDestroyImage(device->getDevice(), depthImage, nullptr);
-    vkFreeMemory(device->getDevice(), depthImageMemory, nullptr);
-
-    for (auto framebuffer : swapchainFramebuffers) {
-        vkDestroyFramebuffer(device->getDevice(), framebuffer, nullptr);
-    }
+    TraceSpan span(device, "Swapchain::recreate");
 
-    for (auto imageView : swapchainImageViews) {
-        vkDestroyImageView(device->getDevice(), imageView, nullptr);
-    }
-
-    vkDestroySwapchainKHR(device->getDevice(), swapchain, nullptr);
+    // Frames in flight may still render to the old images, so everything is retired through the deletion queue
+    Device* device = this->device;
+    VkSwapchainKHR oldSwapchain = swapchain;
+    std::vector<VkImageView> oldImageViews = swapchainImageViews;
+    std::vector<VkFramebuffer> oldFramebuffers = swapchainFramebuffers;
+    VkImage oldDepthImage = depthImage;
+    VkImageView oldDepthImageView = depthImageView;
+    Allocation oldDepthImageAllocation = depthImageAllocation;
 
     this->windowWidth = windowWidth;
     this->windowHeight = windowHeight;
 
     create();
 
+    device->getDeletionQueue()->push([=] () mutable {
+        vkDestroyImageView(device->getDevice(), oldDepthImageView, nullptr);
+        vkDestroyImage(device->getDevice(), oldDepthImage, nullptr);
+        device->getAllocator()->free(oldDepthImageAllocation);
+
+        for (auto framebuffer : oldFramebuffers) {
+            vkDestroyFramebuffer(device->getDevice(), framebuffer, nullptr);
+        }
+
+        for (auto imageView : oldImageViews) {
+            vkDestroyImageView(device->getDevice(), imageView, nullptr);
+        }
+
+        vkDestroySwapchainKHR(device->getDevice(), oldSwapchain, nullptr);
+    });
 }
 
 VkFramebuffer VKFS::Swapchain::getFramebuffer(uint32_t imageIndex) {
@@ -205,6 +204,7 @@ void VKFS::Swapchain::create() {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
+    createInfo.oldSwapchain = swapchain; // VK_NULL_HANDLE on first creation
 
     if (vkCreateSwapchainKHR(device->getDevice(), &createInfo, nullptr, &swapchain) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to create swapchain!");
@@ -284,7 +284,7 @@ void VKFS::Swapchain::create() {
     // Depth
     VkFormat depthFormat = device->findDepthFormat();
 
-    createImage(swapchainExtent.width, swapchainExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+    createImage(swapchainExtent.width, swapchainExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageAllocation);
     depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 
     // Framebuffers
@@ -1,11 +1,18 @@
 #include "../include/VKFS/Synchronization.h"
+#include "../include/VKFS/GPUProfiler.h"
+#include "../include/VKFS/PipelineStatistics.h"
+#include "../include/VKFS/TraceRecorder.h"
 
 VKFS::Synchronization::Synchronization(VKFS::Device *device, VKFS::CommandBuffer *cmd, Swapchain* swapchain) : device(device), cmd(cmd), swapchain(swapchain) {
-    imageAvailableSemaphores.resize(2);
-    renderFinishedSemaphores.resize(2);
-    inFlightFences.resize(2);
-    computeInFlightFences.resize(2);
-    computeFinishedSemaphores.resize(2);
+    const uint32_t framesInFlight = device->getFramesInFlight();
+
+    imageAvailableSemaphores.resize(framesInFlight);
+    renderFinishedSemaphores.resize(framesInFlight);
+    inFlightFences.resize(framesInFlight);
+    computeInFlightFences.resize(framesInFlight);
+    computeFinishedSemaphores.resize(framesInFlight);
+    submissions.resize(framesInFlight, 0);
+    computeSubmissions.resize(framesInFlight, 0);
 
 
     VkSemaphoreCreateInfo semaphoreInfo{};
@@ -15,7 +22,7 @@ VKFS::Synchronization::Synchronization(VKFS::Device *device, VKFS::CommandBuffer
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    for (size_t i = 0; i < 2; i++) {
+    for (size_t i = 0; i < framesInFlight; i++) {
         if (vkCreateSemaphore(device->getDevice(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
             vkCreateSemaphore(device->getDevice(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
             vkCreateFence(device->getDevice(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS ||
@@ -26,11 +33,22 @@ VKFS::Synchronization::Synchronization(VKFS::Device *device, VKFS::CommandBuffer
     }
 }
 
+VKFS::Synchronization::Synchronization(VKFS::Device *device, VKFS::CommandBuffer *cmd) : Synchronization(device, cmd, nullptr) {}
+
 void VKFS::Synchronization::waitForFences() {
+    TraceSpan span(device, "Synchronization::waitForFences");
     vkWaitForFences(device->getDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+
+    device->getDeletionQueue()->completeSubmission(submissions[currentFrame]);
+    device->getDeletionQueue()->collect();
+    device->pollMemoryBudget();
 }
 
 uint32_t VKFS::Synchronization::acquireNextImage() {
+    if (swapchain == nullptr) {
+        throw std::runtime_error("[VKFS] Compute-only synchronization has no swapchain to acquire images from!");
+    }
+
     uint32_t imageIndex;
     VkResult result = vkAcquireNextImageKHR(device->getDevice(), swapchain->getSwapchain(), UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
@@ -54,18 +72,26 @@ void VKFS::Synchronization::resetAll() {
 }
 
 void VKFS::Synchronization::submit(uint32_t imageIndex) {
+    if (swapchain == nullptr) {
+        throw std::runtime_error("[VKFS] Compute-only synchronization can only submit compute work!");
+    }
 
     if (windowWidth == -1 or windowHeight == -1) {
         throw std::runtime_error("[VKFS] The window size must be passed to the Sync object using the pushWindowSize() method every frame!");
     }
 
+    // Uploads recorded so far must reach the queue before the frame that uses them
+    device->getUploadContext()->submit();
+    device->getUploadContext()->acquirePending();
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
     VkSemaphore waitSemaphoresCompute[] = {imageAvailableSemaphores[currentFrame], computeFinishedSemaphores[currentFrame]};
     VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
 
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    // Compute results may be read as indirect draw commands, the earliest stage of the frame
+    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT};
     submitInfo.waitSemaphoreCount = computeInUse ? 2 : 1;
     submitInfo.pWaitSemaphores = computeInUse ? waitSemaphoresCompute : waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
@@ -78,6 +104,8 @@ void VKFS::Synchronization::submit(uint32_t imageIndex) {
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
+    submissions[currentFrame] = device->getDeletionQueue()->beginSubmission(inFlightFences[currentFrame]);
+
     if (vkQueueSubmit(device->getGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to submit draw command buffer!");
     }
@@ -102,7 +130,8 @@ void VKFS::Synchronization::submit(uint32_t imageIndex) {
         throw std::runtime_error("[VKFS] Failed to present swap chain image!");
     }
 
-    currentFrame = (currentFrame + 1) % 2;
+    currentFrame = (currentFrame + 1) % device->getFramesInFlight();
+    frameNumber++;
 }
 
 void VKFS::Synchronization::beginRecordingCommands() {
@@ -112,6 +141,16 @@ void VKFS::Synchronization::beginRecordingCommands() {
     if (vkBeginCommandBuffer(getCommandBuffer(), &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to begin recording command buffer!");
     }
+
+    stateTracker.begin(getCommandBuffer());
+
+    if (profiler != nullptr) {
+        profiler->beginRecording(PROFILE_GRAPHICS);
+    }
+
+    if (statistics != nullptr) {
+        statistics->beginRecording(PROFILE_GRAPHICS);
+    }
 }
 
 void VKFS::Synchronization::endRecordingCommands() {
@@ -124,23 +163,46 @@ uint32_t VKFS::Synchronization::getCurrentFrame() {
     return this->currentFrame;
 }
 
+uint64_t VKFS::Synchronization::getFrameNumber() {
+    return this->frameNumber;
+}
+
+VKFS::Device *VKFS::Synchronization::getDevice() {
+    return this->device;
+}
+
 void VKFS::Synchronization::pushWindowSize(int width, int height) {
     this->windowWidth = width;
     this->windowHeight = height;
 }
 
 void VKFS::Synchronization::submitCompute() {
+    device->getUploadContext()->submit();
+    device->getUploadContext()->acquirePending();
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &cmd->computeBuffers[currentFrame];
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &computeFinishedSemaphores[currentFrame];
+
+    // Without a swapchain no graphics submit waits on the semaphore, so only the fence is signaled
+    if (swapchain != nullptr) {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &computeFinishedSemaphores[currentFrame];
+    }
+
+    computeSubmissions[currentFrame] = device->getDeletionQueue()->beginSubmission(computeInFlightFences[currentFrame]);
 
     if (vkQueueSubmit(device->getComputeQueue(), 1, &submitInfo, computeInFlightFences[currentFrame]) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to submit compute command buffer!");
     };
 
+    if (swapchain == nullptr) {
+        computeInUse = false;
+        currentFrame = (currentFrame + 1) % device->getFramesInFlight();
+        frameNumber++;
+    }
+
 }
 
 void VKFS::Synchronization::resetCompute() {
@@ -149,13 +211,57 @@ void VKFS::Synchronization::resetCompute() {
 }
 
 void VKFS::Synchronization::waitCompute() {
+    TraceSpan span(device, "Synchronization::waitCompute");
     vkWaitForFences(device->getDevice(), 1, &computeInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+
+    device->getDeletionQueue()->completeSubmission(computeSubmissions[currentFrame]);
+    device->getDeletionQueue()->collect();
+
+    // Compute-only frames start here instead of waitForFences()
+    if (swapchain == nullptr) {
+        device->pollMemoryBudget();
+    }
+}
+
+void VKFS::Synchronization::waitComputeIdle() {
+    vkWaitForFences(device->getDevice(), static_cast<uint32_t>(computeInFlightFences.size()), computeInFlightFences.data(), VK_TRUE, UINT64_MAX);
+
+    for (auto submission : computeSubmissions) {
+        device->getDeletionQueue()->completeSubmission(submission);
+    }
+
+    device->getDeletionQueue()->collect();
+    device->pollMemoryBudget();
 }
 
 VkCommandBuffer VKFS::Synchronization::getComputeCommandBuffer() {
     return cmd->computeBuffers[currentFrame];
 }
 
+VKFS::CommandStateTracker *VKFS::Synchronization::getStateTracker() {
+    return &stateTracker;
+}
+
+VKFS::CommandStateTracker *VKFS::Synchronization::getComputeStateTracker() {
+    return &computeStateTracker;
+}
+
+VKFS::GPUProfiler *VKFS::Synchronization::getProfiler() {
+    return this->profiler;
+}
+
+void VKFS::Synchronization::setProfiler(VKFS::GPUProfiler *profiler) {
+    this->profiler = profiler;
+}
+
+VKFS::PipelineStatistics *VKFS::Synchronization::getPipelineStatistics() {
+    return this->statistics;
+}
+
+void VKFS::Synchronization::setPipelineStatistics(VKFS::PipelineStatistics *statistics) {
+    this->statistics = statistics;
+}
+
 void VKFS::Synchronization::beginRecordingCompute() {
     computeInUse = true;
     VkCommandBufferBeginInfo beginInfo{};
@@ -164,6 +270,16 @@ void VKFS::Synchronization::beginRecordingCompute() {
     if (vkBeginCommandBuffer(getComputeCommandBuffer(), &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("[VKFS] Failed to begin recording compute command buffer!");
     }
+
+    computeStateTracker.begin(getComputeCommandBuffer());
+
+    if (profiler != nullptr) {
+        profiler->beginRecording(PROFILE_COMPUTE);
+    }
+
+    if (statistics != nullptr) {
+        statistics->beginRecording(PROFILE_COMPUTE);
+    }
 }
 
 void VKFS::Synchronization::endRecordingCompute() {
@@ -0,0 +1,285 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+#include "../include/VKFS/TraceRecorder.h"
+
+// Process ids of the two timelines in the trace
+static const uint32_t cpuProcess = 1;
+static const uint32_t gpuProcess = 2;
+
+// The CPU and GPU clocks drift apart, calibrated mappings are refreshed this often (ns)
+static const uint64_t recalibrationInterval = 1000000000;
+
+VKFS::TraceRecorder::TraceRecorder(VKFS::Device *device, size_t maxEvents) : device(device), maxEvents(maxEvents) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device->getPhysicalDevice(), &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device->getPhysicalDevice(), &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device->getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+    uint32_t validBits = queueFamilies[device->findQueueFamilies().graphicsFamily.value()].timestampValidBits;
+    timestampMask = validBits >= 64 ? UINT64_MAX : (validBits == 0 ? 0 : (uint64_t(1) << validBits) - 1);
+
+#if defined(__linux__)
+    // std::chrono::steady_clock reads CLOCK_MONOTONIC here, the host domain of the extension
+    auto getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) vkGetInstanceProcAddr(device->getInstance()->getNative(), "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+
+    if (device->hasCalibratedTimestamps() && getTimeDomains != nullptr) {
+        uint32_t domainCount = 0;
+        getTimeDomains(device->getPhysicalDevice(), &domainCount, nullptr);
+        std::vector<VkTimeDomainEXT> domains(domainCount);
+        getTimeDomains(device->getPhysicalDevice(), &domainCount, domains.data());
+
+        bool deviceDomain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+        bool monotonicDomain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT) != domains.end();
+
+        if (deviceDomain && monotonicDomain) {
+            getCalibratedTimestamps = (PFN_vkGetCalibratedTimestampsEXT) vkGetDeviceProcAddr(device->getDevice(), "vkGetCalibratedTimestampsEXT");
+        }
+    }
+#endif
+
+    if (timestampMask != 0) {
+        calibrate();
+    }
+
+    device->setTraceRecorder(this);
+}
+
+VKFS::TraceRecorder::~TraceRecorder() {
+    for (auto& profiler : profilers) {
+        profiler.first->removeResultCallback(profiler.second);
+    }
+
+    device->setTraceRecorder(nullptr);
+}
+
+void VKFS::TraceRecorder::attachProfiler(VKFS::GPUProfiler *profiler) {
+    uint32_t id = profiler->addResultCallback([this] (const std::vector<GPUScope>& scopes) {
+        // Calibration without the extension blocks on a submit, so only the calibrated mapping is refreshed
+        if (getCalibratedTimestamps != nullptr && timestampMask != 0 && now() - lastCalibration > recalibrationInterval) {
+            calibrate();
+        }
+
+        for (auto& scope : scopes) {
+            recordGPU(scope);
+        }
+    });
+
+    profilers.push_back({profiler, id});
+}
+
+void VKFS::TraceRecorder::detachProfiler(VKFS::GPUProfiler *profiler) {
+    for (auto it = profilers.begin(); it != profilers.end();) {
+        if (it->first == profiler) {
+            profiler->removeResultCallback(it->second);
+            it = profilers.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+void VKFS::TraceRecorder::calibrate() {
+    if (getCalibratedTimestamps != nullptr) {
+        VkCalibratedTimestampInfoEXT infos[2]{};
+        infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+        infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        infos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+        uint64_t timestamps[2];
+        uint64_t maxDeviation;
+
+        if (getCalibratedTimestamps(device->getDevice(), 2, infos, timestamps, &maxDeviation) == VK_SUCCESS) {
+            std::lock_guard<std::mutex> lock(mutex);
+            gpuReference = timestamps[0] & timestampMask;
+            cpuReference = timestamps[1];
+            lastCalibration = now();
+            return;
+        }
+    }
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 1;
+
+    VkQueryPool pool;
+    if (vkCreateQueryPool(device->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to create calibration query pool!");
+    }
+
+    VkCommandBuffer commandBuffer = device->beginSingleTimeCommands();
+    vkCmdResetQueryPool(commandBuffer, pool, 0, 1);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, 0);
+
+    uint64_t before = now();
+    device->endSingleTimeCommands(commandBuffer);
+    uint64_t after = now();
+
+    uint64_t timestamp = 0;
+    vkGetQueryPoolResults(device->getDevice(), pool, 0, 1, sizeof(uint64_t), &timestamp, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    vkDestroyQueryPool(device->getDevice(), pool, nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    gpuReference = timestamp & timestampMask;
+    cpuReference = before + (after - before) / 2;
+    lastCalibration = after;
+}
+
+bool VKFS::TraceRecorder::hasCalibratedTimestamps() {
+    return getCalibratedTimestamps != nullptr;
+}
+
+void VKFS::TraceRecorder::recordCPU(const char *name, const char *category, uint64_t start, uint64_t end) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (events.size() >= maxEvents) {
+        return;
+    }
+
+    events.push_back({name, category, start, end - start, cpuProcess, getThreadIndex()});
+}
+
+void VKFS::TraceRecorder::recordGPU(const VKFS::GPUScope &scope) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (events.size() >= maxEvents || timestampMask == 0) {
+        return;
+    }
+
+    uint64_t duration = static_cast<uint64_t>(scope.milliseconds * 1000000.0);
+    events.push_back({scope.name, scope.queue == PROFILE_COMPUTE ? "GPU compute" : "GPU graphics", toCPUTime(scope.beginTicks), duration, gpuProcess, static_cast<uint32_t>(scope.queue)});
+}
+
+void VKFS::TraceRecorder::write(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("[VKFS] Failed to open trace file " + path + "!");
+    }
+
+    uint64_t origin = UINT64_MAX;
+    for (auto& event : events) {
+        origin = std::min(origin, event.start);
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << cpuProcess << ",\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << gpuProcess << ",\"tid\":0,\"args\":{\"name\":\"GPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << gpuProcess << ",\"tid\":" << PROFILE_GRAPHICS << ",\"args\":{\"name\":\"Graphics queue\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << gpuProcess << ",\"tid\":" << PROFILE_COMPUTE << ",\"args\":{\"name\":\"Compute queue\"}}";
+
+    for (auto& thread : threads) {
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << cpuProcess << ",\"tid\":" << thread.second
+             << ",\"args\":{\"name\":\"Thread " << thread.second << "\"}}";
+    }
+
+    char timing[64];
+    for (auto& event : events) {
+        std::string name;
+        for (char c : event.name) {
+            if (c == '"' || c == '\\') {
+                name += '\\';
+            }
+
+            name += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+        }
+
+        // Microseconds with nanosecond precision
+        snprintf(timing, sizeof(timing), "\"ts\":%.3f,\"dur\":%.3f", (event.start - origin) / 1000.0, event.duration / 1000.0);
+
+        file << ",\n{\"name\":\"" << name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\"," << timing
+             << ",\"pid\":" << event.pid << ",\"tid\":" << event.tid << "}";
+    }
+
+    file << "\n]}\n";
+}
+
+void VKFS::TraceRecorder::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.clear();
+}
+
+size_t VKFS::TraceRecorder::getEventCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return events.size();
+}
+
+uint64_t VKFS::TraceRecorder::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t VKFS::TraceRecorder::toCPUTime(uint64_t ticks) {
+    // Masked counters wrap, deltas in the upper half of the range lie before the reference
+    uint64_t delta = (ticks - gpuReference) & timestampMask;
+    int64_t signedDelta = delta > (timestampMask >> 1) ? -static_cast<int64_t>(timestampMask - delta) - 1 : static_cast<int64_t>(delta);
+
+    return cpuReference + static_cast<int64_t>(static_cast<double>(signedDelta) * timestampPeriod);
+}
+
+uint32_t VKFS::TraceRecorder::getThreadIndex() {
+    auto found = threads.find(std::this_thread::get_id());
+    if (found != threads.end()) {
+        return found->second;
+    }
+
+    uint32_t index = static_cast<uint32_t>(threads.size());
+    threads[std::this_thread::get_id()] = index;
+
+    return index;
+}
+
+VKFS::TraceSpan::TraceSpan(VKFS::TraceRecorder *recorder, const char *name, const char *category) : recorder(recorder), name(name), category(category) {
+    if (recorder != nullptr) {
+        start = TraceRecorder::now();
+    }
+}
+
+VKFS::TraceSpan::TraceSpan(VKFS::Device *device, const char *name, const char *category) : device(device), name(name), category(category) {
+    recorder = device->acquireTraceRecorder();
+
+    if (recorder != nullptr) {
+        start = TraceRecorder::now();
+    }
+}
+
+VKFS::TraceSpan::~TraceSpan() {
+    if (recorder != nullptr) {
+        recorder->recordCPU(name, category, start, TraceRecorder::now());
+
+        if (device != nullptr) {
+            device->releaseTraceRecorder();
+        }
+    }
+}
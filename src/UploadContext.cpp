@@ -0,0 +1,526 @@
+/*
+(c) Copyright 2023 MHDtA
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "../include/VKFS/UploadContext.h"
+#include "../include/VKFS/Device.h"
+#include "../include/VKFS/TraceRecorder.h"
+
+VKFS::UploadContext::UploadContext(VKFS::Device *device) : device(device) {
+    QueueFamilyIndices indices = device->findQueueFamilies();
+    graphicsFamily = indices.graphicsFamily.value();
+
+    dedicatedTransfer = device->hasDedicatedTransferQueue();
+    if (dedicatedTransfer) {
+        transferFamily = indices.transferFamily.value();
+        transferCommandPool = device->getTransferCommandPool();
+    } else {
+        transferFamily = graphicsFamily;
+    }
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = graphicsFamily;
+
+    if (vkCreateCommandPool(device->getDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to create upload command pool!");
+    }
+}
+
+VKFS::UploadContext::~UploadContext() {
+    waitIdle();
+
+    for (auto& batch : freeBatches) {
+        vkDestroyFence(device->getDevice(), batch.fence, nullptr);
+
+        if (dedicatedTransfer) {
+            vkFreeCommandBuffers(device->getDevice(), transferCommandPool, 1, &batch.commandBuffer);
+            vkDestroySemaphore(device->getDevice(), batch.transferFinished, nullptr);
+            vkDestroySemaphore(device->getDevice(), batch.releaseFinished, nullptr);
+            vkDestroyFence(device->getDevice(), batch.transferFence, nullptr);
+        }
+    }
+
+    vkDestroyCommandPool(device->getDevice(), commandPool, nullptr);
+}
+
+VKFS::__UploadBatch VKFS::UploadContext::acquireBatch() {
+    if (!freeBatches.empty()) {
+        __UploadBatch batch = std::move(freeBatches.back());
+        freeBatches.pop_back();
+        return batch;
+    }
+
+    __UploadBatch batch;
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(device->getDevice(), &allocInfo, &batch.graphicsCommandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to allocate upload command buffer!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (dedicatedTransfer) {
+        if (vkAllocateCommandBuffers(device->getDevice(), &allocInfo, &batch.releaseCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to allocate upload command buffer!");
+        }
+
+        allocInfo.commandPool = transferCommandPool;
+
+        if (vkAllocateCommandBuffers(device->getDevice(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to allocate transfer command buffer!");
+        }
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        if (vkCreateSemaphore(device->getDevice(), &semaphoreInfo, nullptr, &batch.transferFinished) != VK_SUCCESS ||
+            vkCreateSemaphore(device->getDevice(), &semaphoreInfo, nullptr, &batch.releaseFinished) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to create upload semaphore!");
+        }
+
+        if (vkCreateFence(device->getDevice(), &fenceInfo, nullptr, &batch.transferFence) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to create upload fence!");
+        }
+    } else {
+        batch.commandBuffer = batch.graphicsCommandBuffer;
+    }
+
+    if (vkCreateFence(device->getDevice(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to create upload fence!");
+    }
+
+    return batch;
+}
+
+void VKFS::UploadContext::begin() {
+    collect();
+
+    current = acquireBatch();
+    current.ticket = nextTicket++;
+    current.consumerStages = 0;
+    current.handovers.clear();
+    current.graphicsWritten.clear();
+    current.releasing = false;
+    current.streaming = false;
+    current.acquired = false;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkResetCommandBuffer(current.graphicsCommandBuffer, 0);
+    if (vkBeginCommandBuffer(current.graphicsCommandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to begin recording upload command buffer!");
+    }
+
+    if (dedicatedTransfer) {
+        vkResetCommandBuffer(current.commandBuffer, 0);
+        if (vkBeginCommandBuffer(current.commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to begin recording transfer command buffer!");
+        }
+    }
+
+    recording = true;
+}
+
+VkCommandBuffer VKFS::UploadContext::getCommandBuffer() {
+    if (!recording) begin();
+    return current.commandBuffer;
+}
+
+VkCommandBuffer VKFS::UploadContext::getGraphicsCommandBuffer() {
+    if (!recording) begin();
+    return current.graphicsCommandBuffer;
+}
+
+VKFS::UploadTicket VKFS::UploadContext::getCurrentTicket() {
+    return recording ? current.ticket : nextTicket - 1;
+}
+
+void VKFS::UploadContext::transferBufferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                                                  VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask) {
+    getCommandBuffer();
+    current.consumerStages |= dstStageMask;
+
+    if (!dedicatedTransfer) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = offset;
+        barrier.size = size;
+
+        vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0,
+                             0, nullptr, 1, &barrier, 0, nullptr);
+        return;
+    }
+
+    // The range may still be written again in this batch, so the handover is recorded by submit()
+    for (auto& handover : current.handovers) {
+        if (handover.buffer == buffer && handover.offset == offset && handover.size == size) {
+            handover.dstAccessMask |= dstAccessMask;
+            handover.dstStageMask |= dstStageMask;
+            return;
+        }
+    }
+
+    current.handovers.push_back({buffer, offset, size, dstAccessMask, dstStageMask});
+}
+
+void VKFS::UploadContext::releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+    auto found = graphicsOwned.find(buffer);
+    if (!dedicatedTransfer || found == graphicsOwned.end()) return;
+
+    getCommandBuffer();
+
+    // Already written by this batch, so the transfer queue still holds it
+    for (auto& handover : current.handovers) {
+        if (handover.buffer == buffer && handover.offset <= offset && offset + size <= handover.offset + handover.size) return;
+    }
+
+    if (!current.releasing) {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkResetCommandBuffer(current.releaseCommandBuffer, 0);
+        if (vkBeginCommandBuffer(current.releaseCommandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to begin recording upload command buffer!");
+        }
+
+        current.releasing = true;
+    }
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0; // The range is overwritten, so only earlier reads have to finish
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = graphicsFamily;
+    barrier.dstQueueFamilyIndex = transferFamily;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+
+    // Release once earlier frames are past the stages using it...
+    vkCmdPipelineBarrier(current.releaseCommandBuffer, found->second, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 1, &barrier, 0, nullptr);
+
+    // ...and acquire on the transfer queue, which waits for the release at the transfer stage
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void VKFS::UploadContext::copyBuffer(VkBuffer src, VkBuffer dst, const VkBufferCopy &region, VkAccessFlags dstAccessMask,
+                                     VkPipelineStageFlags dstStageMask, bool onGraphicsQueue) {
+    getCommandBuffer();
+
+    if (!onGraphicsQueue && current.graphicsWritten.count(dst) == 0) {
+        releaseBuffer(dst, region.dstOffset, region.size);
+        vkCmdCopyBuffer(current.commandBuffer, src, dst, 1, &region);
+        transferBufferOwnership(dst, region.dstOffset, region.size, dstAccessMask, dstStageMask);
+        return;
+    }
+
+    // Frames on the graphics queue may still write src or use dst, so the copy is recorded there after them
+    current.consumerStages |= dstStageMask;
+
+    if (dedicatedTransfer) {
+        graphicsOwned[dst] |= dstStageMask;
+        current.graphicsWritten.insert(dst);
+    }
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = dstAccessMask;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(current.graphicsCommandBuffer, dstStageMask, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdCopyBuffer(current.graphicsCommandBuffer, src, dst, 1, &region);
+}
+
+bool VKFS::UploadContext::isOwnedByGraphics(VkBuffer buffer) {
+    return !dedicatedTransfer || graphicsOwned.count(buffer) != 0;
+}
+
+void VKFS::UploadContext::forgetBuffer(VkBuffer buffer) {
+    graphicsOwned.erase(buffer);
+}
+
+void VKFS::UploadContext::transferImageOwnership(VkImage image, VkImageSubresourceRange range, VkImageLayout oldLayout,
+                                                 VkImageLayout newLayout, VkAccessFlags dstAccessMask,
+                                                 VkPipelineStageFlags dstStageMask) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dstAccessMask;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+
+    VkCommandBuffer commandBuffer = getCommandBuffer();
+    current.consumerStages |= dstStageMask;
+
+    if (!dedicatedTransfer) {
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+        return;
+    }
+
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccessMask;
+    vkCmdPipelineBarrier(current.graphicsCommandBuffer, dstStageMask, dstStageMask, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+VKFS::UploadTicket VKFS::UploadContext::submit(bool streaming) {
+    if (!recording) return nextTicket - 1;
+
+    TraceSpan span(device, "UploadContext::submit", "Upload");
+
+    for (auto& handover : current.handovers) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        barrier.buffer = handover.buffer;
+        barrier.offset = handover.offset;
+        barrier.size = handover.size;
+
+        // Release on the transfer queue...
+        vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, 1, &barrier, 0, nullptr);
+
+        // ...and acquire on the graphics queue, at the stages the transfer semaphore is waited at
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = handover.dstAccessMask;
+        vkCmdPipelineBarrier(current.graphicsCommandBuffer, handover.dstStageMask, handover.dstStageMask, 0,
+                             0, nullptr, 1, &barrier, 0, nullptr);
+
+        graphicsOwned[handover.buffer] |= handover.dstStageMask;
+    }
+
+    // Make writes recorded on the graphics queue (or all of them, without a transfer queue) visible to the stages reading
+    // them. Uploads recorded without a handover are made visible to every later command
+    VkPipelineStageFlags consumerStages = current.consumerStages != 0 ? current.consumerStages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+    vkCmdPipelineBarrier(current.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, consumerStages, 0,
+                         1, &barrier,
+                         0, nullptr,
+                         0, nullptr);
+
+    if (vkEndCommandBuffer(current.graphicsCommandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to record upload command buffer!");
+    }
+
+    current.consumerStages = consumerStages;
+    current.streaming = streaming && dedicatedTransfer;
+
+    if (dedicatedTransfer) {
+        VkPipelineStageFlags releaseStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+        if (current.releasing) {
+            // Earlier batches must hand their buffers to the graphics queue before it releases them again
+            for (auto& batch : inFlight) {
+                if (!batch.acquired) acquire(batch);
+            }
+
+            if (vkEndCommandBuffer(current.releaseCommandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("[VKFS] Failed to record upload command buffer!");
+            }
+
+            VkSubmitInfo releaseSubmitInfo{};
+            releaseSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            releaseSubmitInfo.commandBufferCount = 1;
+            releaseSubmitInfo.pCommandBuffers = &current.releaseCommandBuffer;
+            releaseSubmitInfo.signalSemaphoreCount = 1;
+            releaseSubmitInfo.pSignalSemaphores = &current.releaseFinished;
+
+            if (vkQueueSubmit(device->getGraphicsQueue(), 1, &releaseSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("[VKFS] Failed to submit upload command buffer!");
+            }
+        }
+
+        if (vkEndCommandBuffer(current.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to record transfer command buffer!");
+        }
+
+        // The graphics part is submitted by acquirePending(), ahead of the frame that reads the uploads
+        VkSubmitInfo transferSubmitInfo{};
+        transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transferSubmitInfo.commandBufferCount = 1;
+        transferSubmitInfo.pCommandBuffers = &current.commandBuffer;
+        transferSubmitInfo.signalSemaphoreCount = 1;
+        transferSubmitInfo.pSignalSemaphores = &current.transferFinished;
+
+        if (current.releasing) {
+            transferSubmitInfo.waitSemaphoreCount = 1;
+            transferSubmitInfo.pWaitSemaphores = &current.releaseFinished;
+            transferSubmitInfo.pWaitDstStageMask = &releaseStage;
+        }
+
+        vkResetFences(device->getDevice(), 1, &current.transferFence);
+
+        if (vkQueueSubmit(device->getTransferQueue(), 1, &transferSubmitInfo, current.transferFence) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to submit transfer command buffer!");
+        }
+    } else {
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &current.graphicsCommandBuffer;
+
+        vkResetFences(device->getDevice(), 1, &current.fence);
+
+        if (vkQueueSubmit(device->getGraphicsQueue(), 1, &submitInfo, current.fence) != VK_SUCCESS) {
+            throw std::runtime_error("[VKFS] Failed to submit upload command buffer!");
+        }
+
+        current.acquired = true;
+    }
+
+    UploadTicket ticket = current.ticket;
+    inFlight.push_back(std::move(current));
+    current = __UploadBatch{};
+    recording = false;
+
+    return ticket;
+}
+
+void VKFS::UploadContext::acquire(VKFS::__UploadBatch &batch) {
+    // Commands before the consuming stages, e.g. the frame's own transfers and earlier passes, keep running
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &batch.transferFinished;
+    submitInfo.pWaitDstStageMask = &batch.consumerStages;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+
+    vkResetFences(device->getDevice(), 1, &batch.fence);
+
+    if (vkQueueSubmit(device->getGraphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("[VKFS] Failed to submit upload command buffer!");
+    }
+
+    batch.acquired = true;
+}
+
+void VKFS::UploadContext::acquirePending() {
+    for (auto& batch : inFlight) {
+        if (batch.acquired) continue;
+
+        // Streamed batches are picked up by the first frame after their transfer finished
+        if (batch.streaming && vkGetFenceStatus(device->getDevice(), batch.transferFence) != VK_SUCCESS) continue;
+
+        acquire(batch);
+    }
+}
+
+void VKFS::UploadContext::collect() {
+    while (!inFlight.empty() && inFlight.front().acquired && vkGetFenceStatus(device->getDevice(), inFlight.front().fence) == VK_SUCCESS) {
+        __UploadBatch batch = std::move(inFlight.front());
+        inFlight.pop_front();
+
+        for (auto& function : batch.onComplete) {
+            function();
+        }
+
+        batch.onComplete.clear();
+        completedTicket = batch.ticket;
+        freeBatches.push_back(std::move(batch));
+    }
+}
+
+bool VKFS::UploadContext::isComplete(VKFS::UploadTicket ticket) {
+    if (ticket <= completedTicket) return true;
+
+    collect();
+    return ticket <= completedTicket;
+}
+
+void VKFS::UploadContext::wait(VKFS::UploadTicket ticket) {
+    if (ticket <= completedTicket) return;
+
+    TraceSpan span(device, "UploadContext::wait", "Upload");
+
+    if (recording && ticket >= current.ticket) {
+        submit();
+    }
+
+    // Streamed batches may be acquired after later ones, so every batch up to the ticket is waited for
+    for (auto& batch : inFlight) {
+        if (batch.ticket > ticket) break;
+
+        if (!batch.acquired) {
+            acquire(batch);
+        }
+
+        vkWaitForFences(device->getDevice(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    }
+
+    collect();
+}
+
+void VKFS::UploadContext::waitIdle() {
+    wait(submit());
+}
+
+void VKFS::UploadContext::onComplete(std::function<void()> &&function) {
+    if (recording) {
+        current.onComplete.push_back(std::move(function));
+    } else if (!inFlight.empty()) {
+        inFlight.back().onComplete.push_back(std::move(function));
+    } else {
+        function();
+    }
+}
@@ -5,30 +5,36 @@
 #include "../include/VKFS/VKFS.h"
 
 uint32_t VKFS::prepareFrame(Synchronization* sync) {
+    TraceSpan span(sync->getDevice(), "VKFS::prepareFrame");
     sync->waitForFences();
     return sync->acquireNextImage();
 }
 
 void VKFS::begin(Synchronization* sync) {
+    TraceSpan span(sync->getDevice(), "VKFS::begin");
     sync->resetAll();
     sync->beginRecordingCommands();
 }
 
 void VKFS::end(Synchronization* sync, uint32_t imageIndex) {
+    TraceSpan span(sync->getDevice(), "VKFS::end");
     sync->endRecordingCommands();
     sync->submit(imageIndex);
 }
 
 void VKFS::prepareCompute(VKFS::Synchronization *sync) {
+    TraceSpan span(sync->getDevice(), "VKFS::prepareCompute");
     sync->waitCompute();
 }
 
 void VKFS::beginCompute(VKFS::Synchronization *sync) {
+    TraceSpan span(sync->getDevice(), "VKFS::beginCompute");
     sync->resetCompute();
     sync->beginRecordingCompute();
 }
 
 void VKFS::endCompute(VKFS::Synchronization *sync) {
+    TraceSpan span(sync->getDevice(), "VKFS::endCompute");
     sync->endRecordingCompute();
     sync->submitCompute();
 }